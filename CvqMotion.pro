@@ -39,6 +39,8 @@ SOURCES += \
         src/mainwindow.cpp \
     src/videoprocessor.cpp \
     src/entity.cpp \
+    src/entitypool.cpp \
+    src/motionestimator.cpp \
     src/videoprocessorcontroller.cpp \
     src/detectionzone.cpp \
     src/cameraview.cpp \
@@ -47,12 +49,31 @@ SOURCES += \
     src/detectionslisttablemodel.cpp \
     src/aboutdialog.cpp \
     src/detectionsettingsdialog.cpp \
-    src/devicecontrolwidget.cpp
+    src/devicecontrolwidget.cpp \
+    src/engineconfiguration.cpp \
+    src/headlessrunner.cpp \
+    src/enginecomparison.cpp \
+    src/framesource.cpp \
+    src/workerpool.cpp \
+    src/backgroundblender.cpp \
+    src/motionthresholder.cpp \
+    src/framesmoother.cpp \
+    src/framedilator.cpp \
+    src/bitmask.cpp \
+    src/maskmap.cpp \
+    src/blobextractor.cpp \
+    src/rectgrid.cpp \
+    src/rectassigner.cpp \
+    src/overlapscorer.cpp \
+    src/multicameraengine.cpp
 
 HEADERS += \
         src/mainwindow.h \
     src/videoprocessor.h \
     src/entity.h \
+    src/entitypool.h \
+    src/ringbuffer.h \
+    src/motionestimator.h \
     src/videoprocessorcontroller.h \
     src/detectionzone.h \
     src/cameraview.h \
@@ -63,7 +84,28 @@ HEADERS += \
     src/detectionsettingsdialog.h \
     src/videoprocessordetectionsettings.h \
     src/videoprocessorconstants.h \
-    src/devicecontrolwidget.h
+    src/devicecontrolwidget.h \
+    src/engineconfiguration.h \
+    src/headlessrunner.h \
+    src/enginecomparison.h \
+    src/framesource.h \
+    src/boundedqueue.h \
+    src/framepacket.h \
+    src/videoprocessorstatistics.h \
+    src/videoprocessorsnapshot.h \
+    src/bufferaudit.h \
+    src/workerpool.h \
+    src/backgroundblender.h \
+    src/motionthresholder.h \
+    src/framesmoother.h \
+    src/framedilator.h \
+    src/bitmask.h \
+    src/maskmap.h \
+    src/blobextractor.h \
+    src/rectgrid.h \
+    src/rectassigner.h \
+    src/overlapscorer.h \
+    src/multicameraengine.h
 
 FORMS += \
     ui/mainwindow.ui \
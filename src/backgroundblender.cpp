@@ -0,0 +1,216 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CVQM_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+#include "backgroundblender.h"
+
+using namespace std;
+using namespace cvqm;
+
+namespace {
+	constexpr unsigned WEIGHT_ONE = 256;
+
+	unsigned toWeight(float ratio)
+	{
+		float clamped = min(1.0f, max(0.0f, ratio));
+		return static_cast<unsigned>(lround(clamped * WEIGHT_ONE));
+	}
+
+	inline uchar mix(uchar background, uchar frame, unsigned weight)
+	{
+		return static_cast<uchar>((background * (WEIGHT_ONE - weight) + frame * weight) >> 8);
+	}
+}
+
+BackgroundBlender::BackgroundBlender(float backgroundRatio, float foregroundRatio, unsigned long thresholdTimeout) :
+	backgroundWeight(toWeight(backgroundRatio)),
+	foregroundWeight(toWeight(foregroundRatio)),
+	thresholdTimeout(static_cast<ushort>(min<unsigned long>(thresholdTimeout, USHRT_MAX - 1))),
+	blendFunction(selectImplementation())
+{
+}
+
+size_t BackgroundBlender::blend(uchar *background, const uchar *frame, const uchar *mask, ushort *thresholdTime, size_t n) const
+{
+	return blendFunction(*this, background, frame, mask, thresholdTime, n);
+}
+
+size_t BackgroundBlender::blendScalar(const BackgroundBlender &b, uchar *background, const uchar *frame,
+									  const uchar *mask, ushort *thresholdTime, size_t n)
+{
+	size_t threshCount = 0;
+	for(size_t x=0; x < n; x++) {
+		if ( !mask[x] ) {
+			thresholdTime[x] = 0;
+			background[x] = mix(background[x], frame[x], b.backgroundWeight);
+		} else {
+			if ( thresholdTime[x] < USHRT_MAX )
+				thresholdTime[x]++;
+			threshCount++;
+			if ( thresholdTime[x] > b.thresholdTimeout )
+				background[x] = mix(background[x], frame[x], b.foregroundWeight);
+		}
+	}
+	return threshCount;
+}
+
+#if defined(CVQM_X86_DISPATCH) && defined(__SSE2__)
+
+size_t BackgroundBlender::blendSse2(const BackgroundBlender &b, uchar *background, const uchar *frame,
+									const uchar *mask, ushort *thresholdTime, size_t n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i bias = _mm_set1_epi16(SHRT_MIN);
+	const __m128i timeout = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(b.thresholdTimeout)), bias);
+	const __m128i weightOne = _mm_set1_epi16(WEIGHT_ONE);
+	const __m128i bgWeight = _mm_set1_epi16(static_cast<short>(b.backgroundWeight));
+	const __m128i fgWeight = _mm_set1_epi16(static_cast<short>(b.foregroundWeight));
+
+	size_t threshCount = 0;
+	size_t x = 0;
+	for(; x + 16 <= n; x += 16) {
+		__m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + x));
+		__m128i bg8 = _mm_cmpeq_epi8(m, zero);
+		threshCount += __builtin_popcount(~_mm_movemask_epi8(bg8) & 0xFFFF);
+
+		// Step the threshold times of the masked lanes and clear the others
+		__m128i bgLo16 = _mm_unpacklo_epi8(bg8, bg8);
+		__m128i bgHi16 = _mm_unpackhi_epi8(bg8, bg8);
+		__m128i *tpLo = reinterpret_cast<__m128i*>(thresholdTime + x);
+		__m128i *tpHi = reinterpret_cast<__m128i*>(thresholdTime + x + 8);
+		__m128i tLo = _mm_andnot_si128(bgLo16, _mm_adds_epu16(_mm_loadu_si128(tpLo), one));
+		__m128i tHi = _mm_andnot_si128(bgHi16, _mm_adds_epu16(_mm_loadu_si128(tpHi), one));
+		_mm_storeu_si128(tpLo, tLo);
+		_mm_storeu_si128(tpHi, tHi);
+		__m128i expiredLo16 = _mm_cmpgt_epi16(_mm_xor_si128(tLo, bias), timeout);
+		__m128i expiredHi16 = _mm_cmpgt_epi16(_mm_xor_si128(tHi, bias), timeout);
+
+		__m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + x));
+		__m128i *bp = reinterpret_cast<__m128i*>(background + x);
+		__m128i bk = _mm_loadu_si128(bp);
+
+		// Unmasked lanes take the background weight, expired lanes the foreground weight, others zero
+		__m128i wLo = _mm_or_si128(_mm_and_si128(bgLo16, bgWeight), _mm_and_si128(expiredLo16, fgWeight));
+		__m128i wHi = _mm_or_si128(_mm_and_si128(bgHi16, bgWeight), _mm_and_si128(expiredHi16, fgWeight));
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(bk, zero), _mm_sub_epi16(weightOne, wLo)),
+								   _mm_mullo_epi16(_mm_unpacklo_epi8(f, zero), wLo));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(bk, zero), _mm_sub_epi16(weightOne, wHi)),
+								   _mm_mullo_epi16(_mm_unpackhi_epi8(f, zero), wHi));
+		_mm_storeu_si128(bp, _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+	}
+
+	return threshCount + blendScalar(b, background + x, frame + x, mask + x, thresholdTime + x, n - x);
+}
+
+#else
+
+size_t BackgroundBlender::blendSse2(const BackgroundBlender &b, uchar *background, const uchar *frame,
+									const uchar *mask, ushort *thresholdTime, size_t n)
+{
+	return blendScalar(b, background, frame, mask, thresholdTime, n);
+}
+
+#endif
+
+#if defined(CVQM_X86_DISPATCH)
+
+__attribute__((target("avx2")))
+size_t BackgroundBlender::blendAvx2(const BackgroundBlender &b, uchar *background, const uchar *frame,
+									const uchar *mask, ushort *thresholdTime, size_t n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m256i one = _mm256_set1_epi16(1);
+	const __m256i bias = _mm256_set1_epi16(SHRT_MIN);
+	const __m256i timeout = _mm256_xor_si256(_mm256_set1_epi16(static_cast<short>(b.thresholdTimeout)), bias);
+	const __m256i weightOne = _mm256_set1_epi16(WEIGHT_ONE);
+	const __m256i bgWeight = _mm256_set1_epi16(static_cast<short>(b.backgroundWeight));
+	const __m256i fgWeight = _mm256_set1_epi16(static_cast<short>(b.foregroundWeight));
+
+	size_t threshCount = 0;
+	size_t x = 0;
+	for(; x + 16 <= n; x += 16) {
+		__m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + x));
+		__m128i fg8 = _mm_xor_si128(_mm_cmpeq_epi8(m, zero), _mm_set1_epi8(-1));
+		threshCount += __builtin_popcount(_mm_movemask_epi8(fg8));
+		__m256i fg16 = _mm256_cvtepi8_epi16(fg8);
+
+		__m256i *tp = reinterpret_cast<__m256i*>(thresholdTime + x);
+		__m256i t = _mm256_and_si256(_mm256_adds_epu16(_mm256_loadu_si256(tp), one), fg16);
+		_mm256_storeu_si256(tp, t);
+		__m256i expired16 = _mm256_cmpgt_epi16(_mm256_xor_si256(t, bias), timeout);
+
+		__m256i f = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + x)));
+		__m128i *bp = reinterpret_cast<__m128i*>(background + x);
+		__m256i bk = _mm256_cvtepu8_epi16(_mm_loadu_si128(bp));
+
+		__m256i w = _mm256_or_si256(_mm256_andnot_si256(fg16, bgWeight), _mm256_and_si256(expired16, fgWeight));
+		__m256i mixed = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(bk, _mm256_sub_epi16(weightOne, w)),
+														   _mm256_mullo_epi16(f, w)), 8);
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(mixed, mixed), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128(bp, _mm256_castsi256_si128(packed));
+	}
+
+	return threshCount + blendScalar(b, background + x, frame + x, mask + x, thresholdTime + x, n - x);
+}
+
+#else
+
+size_t BackgroundBlender::blendAvx2(const BackgroundBlender &b, uchar *background, const uchar *frame,
+									const uchar *mask, ushort *thresholdTime, size_t n)
+{
+	return blendScalar(b, background, frame, mask, thresholdTime, n);
+}
+
+#endif
+
+BackgroundBlender::BlendFunction BackgroundBlender::selectImplementation()
+{
+	static const BlendFunction selected = []() -> BlendFunction {
+#if defined(CVQM_X86_DISPATCH)
+		__builtin_cpu_init();
+		if ( __builtin_cpu_supports("avx2") )
+			return &BackgroundBlender::blendAvx2;
+#endif
+#if defined(CVQM_X86_DISPATCH) && defined(__SSE2__)
+		return &BackgroundBlender::blendSse2;
+#else
+		return &BackgroundBlender::blendScalar;
+#endif
+	}();
+	return selected;
+}
+
+const char *BackgroundBlender::implementation()
+{
+	BlendFunction f = selectImplementation();
+	if ( f == &BackgroundBlender::blendAvx2 )
+		return "avx2";
+	if ( f == &BackgroundBlender::blendSse2 )
+		return "sse2";
+	return "scalar";
+}
@@ -0,0 +1,72 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef BACKGROUNDBLENDER_H
+#define BACKGROUNDBLENDER_H
+
+#include <cstddef>
+#include <opencv2/opencv.hpp>
+
+namespace cvqm {
+	class BackgroundBlender;
+}
+
+/*
+ * Per-pixel background model update.  Pixels outside the blending mask are
+ * blended toward the frame at the background ratio and have their threshold
+ * time cleared; masked pixels count up their threshold time and are blended
+ * at the foreground ratio once it exceeds the timeout.
+ *
+ * Threshold times are 16 bit counters which saturate rather than wrap, and
+ * timeouts are capped at 65534 frames so that a saturated pixel always
+ * expires.  Blending is done in 8.8 fixed point, so the ratios are quantized
+ * to 1/256.
+ * SSE2 and AVX2 implementations are selected at runtime where available and
+ * produce the same results as the scalar fallback.
+ */
+class cvqm::BackgroundBlender
+{
+private:
+	typedef size_t (*BlendFunction)(const BackgroundBlender &b, uchar *background, const uchar *frame,
+									const uchar *mask, ushort *thresholdTime, size_t n);
+
+	unsigned backgroundWeight;
+	unsigned foregroundWeight;
+	ushort thresholdTimeout;
+	BlendFunction blendFunction;
+
+	static BlendFunction selectImplementation();
+	static size_t blendScalar(const BackgroundBlender &b, uchar *background, const uchar *frame,
+							  const uchar *mask, ushort *thresholdTime, size_t n);
+	static size_t blendSse2(const BackgroundBlender &b, uchar *background, const uchar *frame,
+							const uchar *mask, ushort *thresholdTime, size_t n);
+	static size_t blendAvx2(const BackgroundBlender &b, uchar *background, const uchar *frame,
+							const uchar *mask, ushort *thresholdTime, size_t n);
+
+public:
+	BackgroundBlender(float backgroundRatio, float foregroundRatio, unsigned long thresholdTimeout);
+
+	// Updates n pixels and returns how many of them were masked
+	size_t blend(uchar *background, const uchar *frame, const uchar *mask, ushort *thresholdTime, size_t n) const;
+
+	// Name of the implementation in use, for diagnostics
+	static const char *implementation();
+};
+
+#endif // BACKGROUNDBLENDER_H
@@ -0,0 +1,72 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "bitmask.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+void BitMask::create(int rows, int cols)
+{
+	height = rows;
+	width = cols;
+	words = (cols + 63) / 64;
+	bits.resize(static_cast<size_t>(rows) * words);
+}
+
+void BitMask::packRow(int y, const uchar *bytes)
+{
+	uint64_t *out = row(y);
+	int x = 0;
+	for(int w=0; w < words; w++) {
+		uint64_t word = 0;
+		int end = min(width, x + 64);
+#ifdef __SSE2__
+		// Sixteen pixels to a compare
+		const __m128i zero = _mm_setzero_si128();
+		for(int bit=0; x + 16 <= end; x += 16, bit += 16) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + x));
+			uint64_t set = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))) & 0xFFFF;
+			word |= set << bit;
+		}
+#endif
+		for(; x < end; x++)
+			if ( bytes[x] )
+				word |= uint64_t(1) << (x % 64);
+		out[w] = word;
+	}
+}
+
+void BitMask::unpack(Mat &dst) const
+{
+	CV_Assert( dst.type() == CV_8UC1 && dst.rows == height && dst.cols == width );
+	for(int y=0; y < height; y++) {
+		const uint64_t *in = row(y);
+		uchar *out = dst.ptr(y);
+		for(int x=0; x < width; x++)
+			out[x] = (in[x / 64] >> (x % 64)) & 1 ? 255 : 0;
+	}
+}
@@ -0,0 +1,77 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef BITMASK_H
+#define BITMASK_H
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace cvqm {
+	class BitMask;
+}
+
+/*
+ * A binary image packed one bit per pixel, 64 pixels to a word, with each
+ * row starting on a new word.  Pixel x of a row is bit x % 64 of word
+ * x / 64, and the bits past the last column are always clear, so rows can
+ * be shifted and combined a word at a time.  Storage is kept when the mask
+ * is created again at the same or a smaller size.
+ */
+class cvqm::BitMask
+{
+private:
+	int height = 0;
+	int width = 0;
+	int words = 0;
+	std::vector<uint64_t> bits;
+
+public:
+	void create(int rows, int cols);
+
+	int rows() const { return height; }
+	int cols() const { return width; }
+	int wordsPerRow() const { return words; }
+	uint64_t *row(int y) { return bits.data() + static_cast<size_t>(y) * words; }
+	const uint64_t *row(int y) const { return bits.data() + static_cast<size_t>(y) * words; }
+
+	// Sets the bits of row y where bytes, one per column, are non-zero
+	void packRow(int y, const uchar *bytes);
+
+	// Writes 255 where bits are set and 0 elsewhere into dst, a CV_8UC1
+	// image, or view of one, of the mask's size
+	void unpack(cv::Mat &dst) const;
+
+	// Word w of row shifted so that pixel x takes the value of pixel
+	// x + shift, with pixels outside the row clear
+	static uint64_t shiftedWord(const uint64_t *row, int words, int w, int shift)
+	{
+		int q = shift >> 6;  // floored, for negative shifts
+		int r = shift & 63;
+		auto word = [row, words](int i) { return i >= 0 && i < words ? row[i] : 0; };
+		uint64_t value = word(w + q) >> r;
+		return r ? value | (word(w + q + 1) << (64 - r)) : value;
+	}
+
+	// Mask for the last word of a row, clearing the bits past the last column
+	uint64_t tailMask() const { return width % 64 ? (uint64_t(1) << (width % 64)) - 1 : ~uint64_t(0); }
+};
+
+#endif // BITMASK_H
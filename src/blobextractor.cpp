@@ -0,0 +1,185 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "blobextractor.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+int BlobExtractor::find(int label)
+{
+	int root = label;
+	while ( parent[root] != root )
+		root = parent[root];
+	while ( parent[label] != root ) {
+		int next = parent[label];
+		parent[label] = root;
+		label = next;
+	}
+	return root;
+}
+
+void BlobExtractor::scanRow(const uchar *row, int cols)
+{
+	runs.clear();
+	int x = 0;
+	while ( x < cols ) {
+#ifdef __SSE2__
+		// Most of a dilated mask is empty; skip it sixteen pixels at a time
+		const __m128i zero = _mm_setzero_si128();
+		while ( x + 16 <= cols &&
+				_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)), zero)) == 0xFFFF )
+			x += 16;
+#endif
+		while ( x < cols && !row[x] )
+			x++;
+		if ( x == cols )
+			break;
+		int start = x;
+		while ( x < cols && row[x] )
+			x++;
+		runs.push_back(Run{start, x, -1});
+	}
+}
+
+void BlobExtractor::scanRow(const uint64_t *row, int words, int cols)
+{
+	// Runs start at the lowest set bit, and end at the next clear bit
+	runs.clear();
+	int w = 0;
+	uint64_t word = words > 0 ? row[0] : 0;
+	for(;;) {
+		while ( !word ) {
+			if ( ++w == words )
+				return;
+			word = row[w];
+		}
+		int start = w * 64 + __builtin_ctzll(word);
+		uint64_t clear = ~word & (~uint64_t(0) << (start % 64));
+		while ( !clear ) {
+			if ( ++w == words ) {
+				runs.push_back(Run{start, cols, -1});
+				return;
+			}
+			clear = ~row[w];
+		}
+		int bit = __builtin_ctzll(clear);
+		runs.push_back(Run{start, w * 64 + bit, -1});
+		word = row[w] & (~uint64_t(0) << bit);
+	}
+}
+
+void BlobExtractor::extract(const Mat &mask, vector<Blob> &blobs, Point offset)
+{
+	CV_Assert( mask.type() == CV_8UC1 );
+
+	previousRuns.clear();
+	parent.clear();
+	totals.clear();
+	for(int y=0; y < mask.rows; y++) {
+		scanRow(mask.ptr(y), mask.cols);
+		joinRuns(y);
+	}
+	collect(blobs, offset);
+}
+
+void BlobExtractor::extract(const BitMask &mask, vector<Blob> &blobs, Point offset)
+{
+	previousRuns.clear();
+	parent.clear();
+	totals.clear();
+	for(int y=0; y < mask.rows(); y++) {
+		scanRow(mask.row(y), mask.wordsPerRow(), mask.cols());
+		joinRuns(y);
+	}
+	collect(blobs, offset);
+}
+
+void BlobExtractor::joinRuns(int y)
+{
+	// A run joins every run above it that it touches, diagonals included.
+	// Runs are in column order, so those ending before this one starts
+	// are finished with.
+	size_t above = 0;
+	for(Run &run: runs) {
+		while ( above < previousRuns.size() && previousRuns[above].end < run.start )
+			above++;
+		for(size_t i=above; i < previousRuns.size() && previousRuns[i].start <= run.end; i++) {
+			int label = find(previousRuns[i].label);
+			if ( run.label < 0 ) {
+				run.label = label;
+			} else if ( label != run.label ) {
+				// The lower label is kept as the root, so that blobs stay in
+				// the order they were first seen
+				int root = min(label, run.label);
+				parent[max(label, run.label)] = root;
+				run.label = root;
+			}
+		}
+		if ( run.label < 0 ) {
+			run.label = static_cast<int>(parent.size());
+			parent.push_back(run.label);
+			totals.push_back(Totals{run.start, y, run.end, y + 1, 0, 0, 0});
+		}
+
+		Totals &t = totals[run.label];
+		int length = run.end - run.start;
+		t.x0 = min(t.x0, run.start);
+		t.x1 = max(t.x1, run.end);
+		t.y1 = y + 1;
+		t.area += length;
+		t.sumX += 0.5 * length * (run.start + run.end - 1);
+		t.sumY += static_cast<double>(length) * y;
+	}
+	swap(runs, previousRuns);
+}
+
+void BlobExtractor::collect(vector<Blob> &blobs, Point offset)
+{
+	// Fold each label's totals into its root's
+	blobs.clear();
+	blobIndex.assign(parent.size(), -1);
+	for(size_t label=0; label < parent.size(); label++) {
+		int root = find(static_cast<int>(label));
+		if ( blobIndex[root] < 0 ) {
+			blobIndex[root] = static_cast<int>(blobs.size());
+			blobs.push_back(Blob());
+			Blob &b = blobs.back();
+			b.box = Rect(Point(totals[root].x0, totals[root].y0), Point(totals[root].x1, totals[root].y1));
+		}
+		Blob &b = blobs[blobIndex[root]];
+		const Totals &t = totals[label];
+		b.box |= Rect(Point(t.x0, t.y0), Point(t.x1, t.y1));
+		b.area += t.area;
+		b.centroid.x += t.sumX;
+		b.centroid.y += t.sumY;
+	}
+	for(Blob &b: blobs) {
+		b.centroid.x = b.centroid.x / b.area + offset.x;
+		b.centroid.y = b.centroid.y / b.area + offset.y;
+		b.box += offset;
+	}
+}
@@ -0,0 +1,80 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef BLOBEXTRACTOR_H
+#define BLOBEXTRACTOR_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "bitmask.h"
+
+namespace cvqm {
+	struct Blob;
+	class BlobExtractor;
+}
+
+struct cvqm::Blob {
+	cv::Rect box;
+	int area = 0;         // pixels
+	cv::Point2d centroid;
+};
+
+/*
+ * Finds the 8-connected blobs of the set pixels of a mask, a byte or bit per
+ * pixel, in one pass over its rows.  Each row is split into runs, which are
+ * joined to the runs they touch in the row above with a union-find, and the
+ * bounding box, area and centroid are summed per run as it is found, so no
+ * point lists are built.  A blob lying in a hole of another is reported
+ * separately, where findContours(RETR_EXTERNAL) would not report it.
+ */
+class cvqm::BlobExtractor
+{
+private:
+	struct Run {
+		int start;
+		int end;
+		int label;
+	};
+	struct Totals {
+		int x0, y0, x1, y1;
+		int area;
+		double sumX, sumY;
+	};
+
+	// Kept from call to call so that they are only allocated once
+	std::vector<Run> previousRuns;
+	std::vector<Run> runs;
+	std::vector<int> parent;
+	std::vector<Totals> totals;
+	std::vector<int> blobIndex;
+
+	int find(int label);
+	void scanRow(const uchar *row, int cols);
+	void scanRow(const uint64_t *row, int words, int cols);
+	void joinRuns(int y);
+	void collect(std::vector<Blob> &blobs, cv::Point offset);
+
+public:
+	// Blobs are listed in the order of their first row, and offset by offset
+	void extract(const cv::Mat &mask, std::vector<Blob> &blobs, cv::Point offset = cv::Point());
+	void extract(const BitMask &mask, std::vector<Blob> &blobs, cv::Point offset = cv::Point());
+};
+
+#endif // BLOBEXTRACTOR_H
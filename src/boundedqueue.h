@@ -0,0 +1,107 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace cvqm {
+	template<typename T> class BoundedQueue;
+}
+
+/*
+ * Fixed capacity blocking queue used to hand frames between pipeline stages.
+ * push() blocks while the queue is full and pop() blocks while it is empty.
+ * After close(), push() fails immediately and pop() drains what remains.
+ */
+template<typename T>
+class cvqm::BoundedQueue
+{
+private:
+	std::mutex m;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+	std::deque<T> items;
+	const size_t capacity;
+	bool closed = false;
+
+public:
+	explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+	bool push(T &&item)
+	{
+		std::unique_lock<std::mutex> lock(m);
+		notFull.wait(lock, [this]{ return closed || items.size() < capacity; });
+		if ( closed )
+			return false;
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> lock(m);
+		notEmpty.wait(lock, [this]{ return closed || !items.empty(); });
+		if ( items.empty() )
+			return false;
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	// Non-blocking pop; fails if nothing is queued
+	bool tryPop(T &item)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		if ( items.empty() )
+			return false;
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	bool empty()
+	{
+		std::lock_guard<std::mutex> lock(m);
+		return items.empty();
+	}
+
+	// True once closed and emptied; nothing more will be delivered
+	bool drained()
+	{
+		std::lock_guard<std::mutex> lock(m);
+		return closed && items.empty();
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(m);
+		closed = true;
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,63 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef BUFFERAUDIT_H
+#define BUFFERAUDIT_H
+
+#include <opencv2/opencv.hpp>
+
+namespace cvqm {
+	class BufferAudit;
+}
+
+/*
+ * Counts how many of a set of reusable buffers were (re)allocated by the
+ * operations performed between watch() and reallocations().  Used to verify
+ * that the pipeline runs without heap allocation once it reaches a steady
+ * state.
+ */
+class cvqm::BufferAudit
+{
+private:
+	static constexpr int MAX_WATCHED = 16;
+	const cv::Mat *mats[MAX_WATCHED];
+	const uchar *data[MAX_WATCHED];
+	int count = 0;
+
+public:
+	void watch(const cv::Mat &m)
+	{
+		if ( count < MAX_WATCHED ) {
+			mats[count] = &m;
+			data[count] = m.data;
+			count++;
+		}
+	}
+
+	unsigned long reallocations() const
+	{
+		unsigned long n = 0;
+		for(int i=0; i<count; i++)
+			if ( mats[i]->data != data[i] )
+				n++;
+		return n;
+	}
+};
+
+#endif // BUFFERAUDIT_H
@@ -17,6 +17,7 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  ************************************************************************/
 
+#include <algorithm>
 #include <QPushButton>
 
 #include "detectionsettingsdialog.h"
@@ -46,6 +47,7 @@ DetectionSettingsDialog::DetectionSettingsDialog(QWidget *parent) :
 	ui->lineEdit_dilateDetectionFactor->setValidator(&POSITIVE_DOUBLE);
 	ui->lineEdit_entityTimeout->setValidator(&POSITIVE_INTEGER);
 	ui->lineEdit_thresholdTimeout->setValidator(&POSITIVE_INTEGER);
+	ui->lineEdit_processingScale->setValidator(&POSITIVE_INTEGER);
 
 }
 
@@ -110,6 +112,7 @@ void DetectionSettingsDialog::handleButton(QAbstractButton *button)
 
 void DetectionSettingsDialog::load(cvqm::VideoProcessorDetectionSettings *s)
 {
+	this->loaded = *s;
 	ui->lineEdit_BackgroundBlendRatio->setText(QString::fromStdString(to_string(s->background_blend_ratio)));
 	ui->lineEdit_ForegroundBlendRatio->setText(QString::fromStdString(to_string(s->foreground_blend_ratio)));
 	ui->lineEdit_ForegroundOverloadRatio->setText(QString::fromStdString(to_string(s->foreground_overload_level)));
@@ -124,12 +127,18 @@ void DetectionSettingsDialog::load(cvqm::VideoProcessorDetectionSettings *s)
 	ui->lineEdit_entityTimeout->setText(QString::fromStdString(to_string(s->entity_timeout)));
 	ui->lineEdit_thresholdTimeout->setText(QString::fromStdString(to_string(s->threshold_timeout)));
 	ui->checkBox_Greyscale->setChecked(s->greyscale);
+	ui->comboBox_blurEngine->setCurrentIndex(s->blur_engine); // items are in BlurEngine order
+	ui->lineEdit_processingScale->setText(QString::fromStdString(to_string(s->processing_scale)));
+	ui->comboBox_dilateEngine->setCurrentIndex(s->dilate_engine); // items are in DilateEngine order
+	ui->comboBox_assignEngine->setCurrentIndex(s->assign_engine); // items are in AssignEngine order
+	ui->comboBox_motionModel->setCurrentIndex(s->motion_model); // items are in MotionModel order
 
 }
 
 void DetectionSettingsDialog::apply()
 {
-	auto *s = new cvqm::VideoProcessorDetectionSettings();
+	// Settings without a field in this dialog keep their loaded values
+	auto *s = new cvqm::VideoProcessorDetectionSettings(this->loaded);
 	s->background_blend_ratio = floatFrom(ui->lineEdit_BackgroundBlendRatio);
 	s->foreground_blend_ratio = floatFrom(ui->lineEdit_ForegroundBlendRatio);
 	s->foreground_overload_level = floatFrom(ui->lineEdit_ForegroundOverloadRatio);
@@ -144,6 +153,11 @@ void DetectionSettingsDialog::apply()
 	s->entity_timeout = longFrom(ui->lineEdit_entityTimeout);
 	s->threshold_timeout = longFrom(ui->lineEdit_thresholdTimeout);
 	s->greyscale = ui->checkBox_Greyscale->checkState() == Qt::CheckState::Checked;
+	s->blur_engine = static_cast<cvqm::BlurEngine>(ui->comboBox_blurEngine->currentIndex());
+	s->processing_scale = max(1, intFrom(ui->lineEdit_processingScale));
+	s->dilate_engine = static_cast<cvqm::DilateEngine>(ui->comboBox_dilateEngine->currentIndex());
+	s->assign_engine = static_cast<cvqm::AssignEngine>(ui->comboBox_assignEngine->currentIndex());
+	s->motion_model = static_cast<cvqm::MotionModel>(ui->comboBox_motionModel->currentIndex());
 	applySettings(shared_ptr<cvqm::VideoProcessorDetectionSettings>(s));
 }
 
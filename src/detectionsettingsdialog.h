@@ -37,6 +37,7 @@ class DetectionSettingsDialog : public QDialog
 	Q_OBJECT
 private:
 	Ui::DetectionSettingsDialog *ui;
+	cvqm::VideoProcessorDetectionSettings loaded;
 	int intFrom(QLineEdit *edit);
 	double doubleFrom(QLineEdit *edit);
 	float floatFrom(QLineEdit *edit);
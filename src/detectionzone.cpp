@@ -39,10 +39,19 @@ DetectionZone::DetectionZone(string name, cv::Rect zone, double pixelsPerMeter,
 		throw out_of_range("DetectionZone::DetectionZone: acceptWidth out of range");
 }
 
-bool DetectionZone::acceptableAngle(double angle)
+bool DetectionZone::acceptableAngle(double angle) const
 {
 	double minAngle = acceptAngle + M_PI*2.0 - 0.5 * acceptWidth;
 	double maxAngle = acceptAngle + M_PI*2.0 + 0.5 * acceptWidth;
 	angle += M_PI*2.0;
 	return angle > minAngle && angle < maxAngle;
 }
+
+DetectionZone DetectionZone::fromDegrees(string name, cv::Rect zone, double pixelsPerMeter, bool directional, double acceptAngle, double acceptWidth)
+{
+	acceptAngle = acceptAngle * M_PI / 180.0 - 0.5*M_PI;
+	if ( acceptAngle < 0 )
+		acceptAngle += 2*M_PI;
+	acceptWidth = acceptWidth * M_PI / 180.0;
+	return DetectionZone(name, zone, pixelsPerMeter, directional, acceptAngle, acceptWidth);
+}
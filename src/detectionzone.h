@@ -38,7 +38,10 @@ public:
 	const double acceptWidth;
 
 	DetectionZone(std::string name, cv::Rect zone, double pixelsPerMeter, bool directional, double acceptAngle, double acceptWidth);
-	bool acceptableAngle(double angle);
+	bool acceptableAngle(double angle) const;
+
+	// Construct from a cardinal accept angle and width in degrees, as entered by the user
+	static DetectionZone fromDegrees(std::string name, cv::Rect zone, double pixelsPerMeter, bool directional, double acceptAngle, double acceptWidth);
 };
 
 
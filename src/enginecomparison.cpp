@@ -0,0 +1,201 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "enginecomparison.h"
+#include "headlessrunner.h"
+
+using namespace std;
+using namespace cv;
+using namespace cvqm;
+
+EngineComparison::EngineComparison(const EngineConfiguration &config, const vector<string> &changes)
+{
+	if ( config.inputFile.empty() )
+		throw invalid_argument("EngineComparison: needs a recording, as a camera cannot give both the same frames");
+
+	EngineConfiguration changed = config;
+	for(const string &change: changes) {
+		EngineConfiguration::applySetting(change, changed.settings);
+		this->changes += (this->changes.empty() ? "" : " ") + change;
+	}
+	HeadlessRunner::configure(sides[0].p, config);
+	HeadlessRunner::configure(sides[1].p, changed);
+	for(Side &side: sides) {
+		side.p.retainMasks.store(true);
+		side.p.detectionObserver = &side;
+	}
+}
+
+void EngineComparison::Side::detected(const DetectionZone *zone, Entity *e, Mat &)
+{
+	double dir, vel;
+	e->calculateVelocityBearing(vel, dir, zone->pixelsPerMeter);
+	detections.push_back(Detection(zone->name, e->id, vel, dir));
+}
+
+unsigned long EngineComparison::run(ostream &out, ostream &report)
+{
+	for(Side &side: sides)
+		if ( !side.p.open() )
+			throw runtime_error("EngineComparison: unable to read the recording");
+
+	out << "frame,time,pixels_a_ms,pixels_b_ms,mask_differences,rects_a,rects_b,changed_rects,unmatched_rects,"
+		<< "detections_a,detections_b,changed_detections" << endl;
+
+	unsigned long frames = 0;
+	double pixelTime[2] = {};
+	unsigned long differingFrames = 0;
+	unsigned long maskFrames = 0;
+	double maskDifferences = 0;
+	double maskPixels = 0;
+	unsigned long rectFrames = 0;
+	unsigned long rects = 0;
+	unsigned long changed = 0;
+	unsigned long unmatched = 0;
+	unsigned long detections[2] = {};
+	double speeds[2] = {};
+	unsigned long changedDetections = 0;
+	for(;;) {
+		bool captured = sides[0].p.captureFrame(sides[0].packet);
+		if ( sides[1].p.captureFrame(sides[1].packet) != captured )
+			throw runtime_error("EngineComparison: the two readers of the recording fell out of step");
+		if ( !captured )
+			break;
+
+		// The pixel stage is timed, with the sides taking turns to go first
+		// so that neither always finds the frame in cache
+		double ms[2];
+		for(int k=0; k < 2; k++) {
+			int i = (frames + k) % 2;
+			auto start = chrono::steady_clock::now();
+			sides[i].p.processPixels(sides[i].packet);
+			ms[i] = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			pixelTime[i] += ms[i];
+		}
+		for(Side &side: sides) {
+			side.detections.clear();
+			side.p.trackFrame(side.packet);
+		}
+
+		// Masks at different processing scales are not compared
+		const FramePacket &a = sides[0].packet;
+		const FramePacket &b = sides[1].packet;
+		int masks = -1;
+		if ( a.dilatedDetection.size() == b.dilatedDetection.size() ) {
+			masks = countNonZero(a.dilatedDetection != b.dilatedDetection);
+			maskDifferences += masks;
+			maskPixels += a.dilatedDetection.total();
+			if ( masks > 0 )
+				maskFrames++;
+		}
+		int changedHere = changedRects(a.rects, b.rects);
+		int unmatchedHere = unmatchedRects(a.rects, b.rects);
+		rects += a.rects.size() + b.rects.size();
+		changed += changedHere;
+		unmatched += unmatchedHere;
+		if ( changedHere > 0 )
+			rectFrames++;
+		for(int i=0; i < 2; i++) {
+			detections[i] += sides[i].detections.size();
+			for(const Detection &d: sides[i].detections)
+				speeds[i] += get<2>(d);
+		}
+		int detectionsA = static_cast<int>(sides[0].detections.size());
+		int detectionsB = static_cast<int>(sides[1].detections.size());
+		int changedDetectionsHere = unpaired(sides[0].detections, sides[1].detections, less<Detection>());
+		changedDetections += changedDetectionsHere;
+		if ( masks > 0 || changedHere > 0 || changedDetectionsHere > 0 )
+			differingFrames++;
+		frames++;
+
+		out << a.frameId << "," << a.frameTime << "," << ms[0] << "," << ms[1] << ",";
+		if ( masks >= 0 )
+			out << masks;
+		out << "," << a.rects.size() << "," << b.rects.size() << "," << changedHere << "," << unmatchedHere << ","
+			<< detectionsA << "," << detectionsB << "," << changedDetectionsHere << endl;
+	}
+	for(Side &side: sides)
+		side.p.close();
+
+	report << "Compared " << frames << " frames against " << changes << ": pixel stage "
+		   << (frames > 0 ? pixelTime[0] / frames : 0) << " ms against " << (frames > 0 ? pixelTime[1] / frames : 0)
+		   << " ms a frame; " << differingFrames << " differed; masks in " << maskFrames << " frames ("
+		   << (maskPixels > 0 ? 100 * maskDifferences / maskPixels : 0) << "% of pixels), rects in "
+		   << rectFrames << " frames (" << changed << " of " << rects << " without an identical rect on the other side, "
+		   << unmatched << " without one overlapping it by half), detections " << detections[0] << " against "
+		   << detections[1] << " (" << changedDetections << " logged by one side only, mean speed "
+		   << (detections[0] > 0 ? speeds[0] / detections[0] : 0) << " against "
+		   << (detections[1] > 0 ? speeds[1] / detections[1] : 0) << " km/h)" << endl;
+	return differingFrames;
+}
+
+template<typename T, typename Less>
+int EngineComparison::unpaired(vector<T> &a, vector<T> &b, Less less)
+{
+	sort(a.begin(), a.end(), less);
+	sort(b.begin(), b.end(), less);
+	int matched = 0;
+	auto i = a.begin();
+	auto j = b.begin();
+	while ( i != a.end() && j != b.end() ) {
+		if ( less(*i, *j) ) {
+			++i;
+		} else if ( less(*j, *i) ) {
+			++j;
+		} else {
+			matched++;
+			++i;
+			++j;
+		}
+	}
+	return static_cast<int>(a.size() + b.size()) - 2 * matched;
+}
+
+int EngineComparison::changedRects(const vector<Rect> &a, const vector<Rect> &b)
+{
+	sorted[0].assign(a.begin(), a.end());
+	sorted[1].assign(b.begin(), b.end());
+	return unpaired(sorted[0], sorted[1], [](const Rect &r, const Rect &s) {
+		return r.y != s.y ? r.y < s.y : r.x != s.x ? r.x < s.x :
+			   r.width != s.width ? r.width < s.width : r.height < s.height;
+	});
+}
+
+int EngineComparison::unmatchedRects(const vector<Rect> &a, const vector<Rect> &b)
+{
+	// Paired first come, first served, when their intersection is at least
+	// half their union
+	taken.assign(b.size(), 0);
+	int paired = 0;
+	for(const Rect &r: a) {
+		for(size_t j=0; j < b.size(); j++) {
+			int common = (r & b[j]).area();
+			if ( !taken[j] && common > 0 && 2 * common >= r.area() + b[j].area() - common ) {
+				taken[j] = 1;
+				paired++;
+				break;
+			}
+		}
+	}
+	return static_cast<int>(a.size() + b.size()) - 2 * paired;
+}
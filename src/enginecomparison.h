@@ -0,0 +1,84 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef ENGINECOMPARISON_H
+#define ENGINECOMPARISON_H
+
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "videoprocessor.h"
+#include "engineconfiguration.h"
+
+namespace cvqm {
+	class EngineComparison;
+}
+
+/*
+ * Runs a recording through two VideoProcessors side by side, one with the
+ * configuration as loaded and the other with some of its settings changed,
+ * and reports frame by frame how long each took over its pixel stage, and
+ * where their results part: pixels of the dilated detection mask, rects
+ * found by only one of them, exactly or roughly, and detections logged by
+ * only one of them.  Each reads the recording itself, and both are stepped
+ * through the pipeline stages on one thread, so they see the same frames
+ * in the same order.
+ */
+class cvqm::EngineComparison
+{
+private:
+	// Zone, entity, speed and direction, as the headless CSV logs them
+	typedef std::tuple<std::string, ulong, double, double> Detection;
+
+	class Side : public DetectionObserver {
+	public:
+		VideoProcessor p;
+		FramePacket packet;
+		std::vector<Detection> detections;  // this frame's
+
+		void detected(const DetectionZone *zone, Entity *e, cv::Mat &frame) override;
+	};
+
+	Side sides[2];
+	std::string changes;
+	std::vector<cv::Rect> sorted[2];
+	std::vector<char> taken;
+
+	// Sorts both and counts the items left once equal ones are paired
+	template<typename T, typename Less>
+	static int unpaired(std::vector<T> &a, std::vector<T> &b, Less less);
+
+	// Rects of either side with no identical rect on the other, and with
+	// none overlapping them by at least half their union
+	int changedRects(const std::vector<cv::Rect> &a, const std::vector<cv::Rect> &b);
+	int unmatchedRects(const std::vector<cv::Rect> &a, const std::vector<cv::Rect> &b);
+
+public:
+	// The configuration must name a recording, given as its input
+	EngineComparison(const EngineConfiguration &config, const std::vector<std::string> &changes);
+
+	// Writes a CSV line per frame to out and the totals to report, and
+	// returns the number of frames in which the two differed
+	unsigned long run(std::ostream &out, std::ostream &report);
+};
+
+#endif // ENGINECOMPARISON_H
@@ -0,0 +1,235 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <stdexcept>
+#include <string>
+
+#include "framesmoother.h"
+#include "framedilator.h"
+#include "rectassigner.h"
+#include "motionestimator.h"
+#include "engineconfiguration.h"
+
+using namespace std;
+using namespace cv;
+using namespace cvqm;
+
+// Each returns whether the key was present
+static bool readIfPresent(const FileNode &node, const char name[], int &value)
+{
+	if ( node[name].empty() )
+		return false;
+	value = static_cast<int>(node[name]);
+	return true;
+}
+
+static bool readIfPresent(const FileNode &node, const char name[], double &value)
+{
+	if ( node[name].empty() )
+		return false;
+	value = static_cast<double>(node[name]);
+	return true;
+}
+
+static bool readIfPresent(const FileNode &node, const char name[], float &value)
+{
+	if ( node[name].empty() )
+		return false;
+	value = static_cast<float>(node[name]);
+	return true;
+}
+
+static bool readIfPresent(const FileNode &node, const char name[], unsigned long &value)
+{
+	if ( node[name].empty() )
+		return false;
+	int v = static_cast<int>(node[name]);
+	if ( v < 0 )
+		throw out_of_range(string("EngineConfiguration: negative value for ") + name);
+	value = static_cast<unsigned long>(v);
+	return true;
+}
+
+static bool readIfPresent(const FileNode &node, const char name[], bool &value)
+{
+	if ( node[name].empty() )
+		return false;
+	value = static_cast<int>(node[name]) != 0;
+	return true;
+}
+
+template<typename Engine>
+static bool readEngineIfPresent(const FileNode &node, const char name[], Engine &value,
+								bool (*parse)(const string&, Engine&))
+{
+	if ( node[name].empty() )
+		return false;
+	if ( !parse(static_cast<string>(node[name]), value) )
+		throw invalid_argument(string("EngineConfiguration: unknown ") + name + " " + static_cast<string>(node[name]));
+	return true;
+}
+
+static bool readIfPresent(const FileNode &node, const char name[], BlurEngine &value)
+{
+	return readEngineIfPresent(node, name, value, &FrameSmoother::parse);
+}
+
+static bool readIfPresent(const FileNode &node, const char name[], DilateEngine &value)
+{
+	return readEngineIfPresent(node, name, value, &FrameDilator::parse);
+}
+
+static bool readIfPresent(const FileNode &node, const char name[], AssignEngine &value)
+{
+	return readEngineIfPresent(node, name, value, &RectAssigner::parse);
+}
+
+static bool readIfPresent(const FileNode &node, const char name[], MotionModel &value)
+{
+	return readEngineIfPresent(node, name, value, &MotionEstimator::parse);
+}
+
+static int readRequired(const FileNode &node, const char name[])
+{
+	if ( node[name].empty() )
+		throw invalid_argument(string("EngineConfiguration: missing required key ") + name);
+	return static_cast<int>(node[name]);
+}
+
+EngineConfiguration EngineConfiguration::load(const string &path)
+{
+	FileStorage fs(path, FileStorage::READ);
+	if ( !fs.isOpened() )
+		throw invalid_argument("EngineConfiguration: unable to open " + path);
+
+	EngineConfiguration c;
+	FileNode root = fs.root();
+	c.name = root["name"].empty() ? path : static_cast<string>(root["name"]);
+	readIfPresent(root, "device", c.deviceId);
+	if ( !root["input"].empty() )
+		c.inputFile = static_cast<string>(root["input"]);
+	readIfPresent(root, "inputFps", c.inputFps);
+
+	FileNode resolution = root["resolution"];
+	if ( !resolution.empty() ) {
+		if ( !resolution.isSeq() || resolution.size() != 2 )
+			throw invalid_argument("EngineConfiguration: resolution must be [ width, height ]");
+		c.xRes = static_cast<int>(resolution[0]);
+		c.yRes = static_cast<int>(resolution[1]);
+	}
+
+	FileNode settings = root["settings"];
+	if ( !settings.empty() )
+		loadSettings(settings, c.settings);
+
+	FileNode zones = root["detectionZones"];
+	for(FileNodeIterator it = zones.begin(); it != zones.end(); ++it)
+		c.detectionZones.push_back(loadDetectionZone(*it));
+
+	FileNode masks = root["maskZones"];
+	for(FileNodeIterator it = masks.begin(); it != masks.end(); ++it)
+		c.maskZones.push_back(loadRect(*it));
+
+	FileNode polygons = root["maskPolygons"];
+	for(FileNodeIterator it = polygons.begin(); it != polygons.end(); ++it)
+		c.maskPolygons.push_back(loadPolygon(*it));
+
+	return c;
+}
+
+void EngineConfiguration::applySetting(const string &assignment, VideoProcessorDetectionSettings &s)
+{
+	size_t equals = assignment.find('=');
+	if ( equals == string::npos || equals == 0 )
+		throw invalid_argument("EngineConfiguration: expected setting=value, not " + assignment);
+
+	// Read as a one line settings map, so values parse as in a file
+	string name = assignment.substr(0, equals);
+	FileStorage fs("%YAML:1.0\n" + name + ": " + assignment.substr(equals + 1) + "\n",
+				   FileStorage::READ | FileStorage::MEMORY);
+	if ( loadSettings(fs.root(), s) == 0 )
+		throw invalid_argument("EngineConfiguration: unknown setting " + name);
+}
+
+int EngineConfiguration::loadSettings(const FileNode &node, VideoProcessorDetectionSettings &s)
+{
+	int found = 0;
+	found += readIfPresent(node, "blur_radius", s.blur_radius);
+	found += readIfPresent(node, "blur_stdev", s.blur_stdev);
+	found += readIfPresent(node, "blur_engine", s.blur_engine);
+	found += readIfPresent(node, "blending_threshold", s.blending_threshold);
+	found += readIfPresent(node, "detection_threshold", s.detection_threshold);
+	found += readIfPresent(node, "threshold_timeout", s.threshold_timeout);
+	found += readIfPresent(node, "entity_timeout", s.entity_timeout);
+	found += readIfPresent(node, "detection_timeout", s.detection_timeout);
+	found += readIfPresent(node, "background_blend_ratio", s.background_blend_ratio);
+	found += readIfPresent(node, "foreground_blend_ratio", s.foreground_blend_ratio);
+	found += readIfPresent(node, "foreground_overload_level", s.foreground_overload_level);
+	found += readIfPresent(node, "dilateDetectionFactor", s.dilateDetectionFactor);
+	found += readIfPresent(node, "dilateBlendingFactor", s.dilateBlendingFactor);
+	found += readIfPresent(node, "dilate_engine", s.dilate_engine);
+	found += readIfPresent(node, "assign_engine", s.assign_engine);
+	found += readIfPresent(node, "motion_model", s.motion_model);
+	found += readIfPresent(node, "borderWidth", s.borderWidth);
+	found += readIfPresent(node, "greyscale", s.greyscale);
+	found += readIfPresent(node, "processing_scale", s.processing_scale);
+	found += readIfPresent(node, "blurred_background", s.blurred_background);
+	found += readIfPresent(node, "pixel_threads", s.pixel_threads);
+	found += readIfPresent(node, "strip_rows", s.strip_rows);
+	found += readIfPresent(node, "restrict_to_zones", s.restrict_to_zones);
+	found += readIfPresent(node, "zone_margin", s.zone_margin);
+	return found;
+}
+
+DetectionZone EngineConfiguration::loadDetectionZone(const FileNode &node)
+{
+	string name;
+	if ( !node["name"].empty() )
+		name = static_cast<string>(node["name"]);
+	double pixelsPerMeter = 1;
+	readIfPresent(node, "pixelsPerMeter", pixelsPerMeter);
+	bool directional = false;
+	readIfPresent(node, "directional", directional);
+	double acceptAngle = 0;
+	readIfPresent(node, "acceptAngle", acceptAngle);
+	double acceptWidth = 360;
+	readIfPresent(node, "acceptWidth", acceptWidth);
+
+	return DetectionZone::fromDegrees(name, loadRect(node), pixelsPerMeter, directional, acceptAngle, acceptWidth);
+}
+
+Rect EngineConfiguration::loadRect(const FileNode &node)
+{
+	return Rect(readRequired(node, "x"), readRequired(node, "y"),
+				readRequired(node, "width"), readRequired(node, "height"));
+}
+
+vector<Point> EngineConfiguration::loadPolygon(const FileNode &node)
+{
+	if ( !node.isSeq() || node.size() < 3 )
+		throw invalid_argument("EngineConfiguration: a mask polygon needs at least three [ x, y ] points");
+	vector<Point> polygon;
+	for(FileNodeIterator it = node.begin(); it != node.end(); ++it) {
+		FileNode point = *it;
+		if ( !point.isSeq() || point.size() != 2 )
+			throw invalid_argument("EngineConfiguration: mask polygon points must be [ x, y ]");
+		polygon.push_back(Point(static_cast<int>(point[0]), static_cast<int>(point[1])));
+	}
+	return polygon;
+}
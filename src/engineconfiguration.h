@@ -0,0 +1,84 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef ENGINECONFIGURATION_H
+#define ENGINECONFIGURATION_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "detectionzone.h"
+#include "videoprocessordetectionsettings.h"
+
+namespace cvqm {
+	class EngineConfiguration;
+}
+
+/*
+ * Configuration for running a VideoProcessor without the GUI.  Loaded from
+ * a YAML, XML or JSON file readable by cv::FileStorage, e.g.:
+ *
+ *   %YAML:1.0
+ *   name: "North approach"     # optional, defaults to the file name
+ *   device: 0
+ *   resolution: [ 640, 480 ]
+ *   input: "recording.mp4"      # optional, replaces the capture device
+ *   inputFps: 25                # optional, overrides container timestamps
+ *   settings: { blur_radius: 13, detection_threshold: 20 }
+ *   detectionZones:
+ *     - { name: "Eastbound", x: 100, y: 200, width: 80, height: 40,
+ *         pixelsPerMeter: 11.5, directional: 1, acceptAngle: 90, acceptWidth: 90 }
+ *   maskZones:
+ *     - { x: 0, y: 0, width: 640, height: 60 }
+ *   maskPolygons:
+ *     - [ [ 400, 480 ], [ 640, 300 ], [ 640, 480 ] ]
+ *
+ * Every key is optional; settings that are not present keep their defaults.
+ * Zone angles are cardinal degrees, as entered in the detection zone dialog.
+ */
+class cvqm::EngineConfiguration
+{
+public:
+	std::string name;
+	int deviceId = 0;
+	int xRes = 640;
+	int yRes = 480;
+	std::string inputFile;
+	double inputFps = 0;
+	VideoProcessorDetectionSettings settings;
+	std::vector<DetectionZone> detectionZones;
+	std::vector<cv::Rect> maskZones;
+	std::vector<std::vector<cv::Point>> maskPolygons;
+
+	static EngineConfiguration load(const std::string &path);
+
+	// Changes one setting, given as "name=value" with the value written as
+	// in a configuration file, e.g. "blur_engine=stack"
+	static void applySetting(const std::string &assignment, VideoProcessorDetectionSettings &s);
+
+private:
+	// Returns how many settings were present
+	static int loadSettings(const cv::FileNode &node, VideoProcessorDetectionSettings &s);
+	static DetectionZone loadDetectionZone(const cv::FileNode &node);
+	static cv::Rect loadRect(const cv::FileNode &node);
+	static std::vector<cv::Point> loadPolygon(const cv::FileNode &node);
+};
+
+#endif // ENGINECONFIGURATION_H
@@ -32,23 +32,11 @@ Entity::Entity(Rect &box, ulong lastUpdateFrameId)
 	this->lastUpdateFrameId = lastUpdateFrameId;
 }
 
-Entity::~Entity()
-{
-	for(auto it: bbHistory) {
-		delete it;
-	}
-}
-
 Rect Entity::deadRecon(double frameTime)
 {
-	double dt;
-	if ( bbHistory.empty() )
-		dt = 0;
-	else
-		dt = frameTime - bbHistory.front()->first;
-
-	return Rect(box.x + static_cast<int>(vel[0]*dt),
-			box.y + static_cast<int>(vel[1]*dt), box.width, box.height);
+	Point2d shift = motion.displacement(frameTime);
+	return Rect(box.x + static_cast<int>(shift.x),
+			box.y + static_cast<int>(shift.y), box.width, box.height);
 }
 
 void Entity::assignId(ulong id)
@@ -56,14 +44,6 @@ void Entity::assignId(ulong id)
 	this->id = id;
 }
 
-void Entity::calculateVelocity(Rect &r1, Rect &r2, double velocity[], double dt, double multiplier)
-{
-	double dx = (r1.x + r1.width*0.5) - (r2.x + r2.width*0.5);
-	double dy = (r1.y + r1.height*0.5) - (r2.y + r2.height*0.5);
-	velocity[0] = dx/dt * multiplier;
-	velocity[1] = dy/dt * multiplier;
-}
-
 double Entity::getBearingRadians()
 {
 	double bearing = atan2(this->vel[1],this->vel[0]);
@@ -82,24 +62,14 @@ void Entity::calculateVelocityBearing(double &vel, double &bearing, double pixel
 		bearing += 360.0;
 }
 
-void Entity::update(Rect *newBox, ulong frameId, double frameTime)
+void Entity::update(Rect *newBox, ulong frameId, double frameTime, MotionModel model)
 {
-	pair<double, Rect>* newer = new pair<double, Rect>(frameTime, *newBox);
 	this->box = *newBox;
-	this->bbHistory.push_front(newer);
-	this->vel[0] = 0;
-	this->vel[1] = 0;
-
-	auto it=bbHistory.begin();
-	it++;
-	int count=0;
-	for(; bbHistory.end() != it && count++ < 10; ++it) {
-		double velocity[2];
-		calculateVelocity(newer->second, (*it)->second, velocity, newer->first - (*it)->first, 1.0/10);
-		this->vel[0] += velocity[0];
-		this->vel[1] += velocity[1];
-		newer = *it;
-	}
+	this->bbHistory.push_front(make_pair(frameTime, *newBox));
+	motion.add(model, frameTime, Point2d(newBox->x + newBox->width*0.5, newBox->y + newBox->height*0.5));
+	Point2d velocity = motion.getVelocity();
+	this->vel[0] = velocity.x;
+	this->vel[1] = velocity.y;
 	this->lastUpdateFrameId = frameId;
 }
 
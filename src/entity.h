@@ -20,11 +20,13 @@
 #ifndef ENTITY_H
 #define ENTITY_H
 
-#include <list>
 #include <map>
+#include <memory>
 #include <opencv2/opencv.hpp>
 
 #include "detectionzone.h"
+#include "ringbuffer.h"
+#include "motionestimator.h"
 
 namespace cvqm {
 	class Entity;
@@ -33,8 +35,12 @@ namespace cvqm {
 class cvqm::Entity
 {
 public:
-	std::list<std::pair<double, cv::Rect>*> bbHistory;
-	std::map<DetectionZone *, ulong> detections;
+	// Update times and boxes, newest first.  The last two are enough to
+	// tell a blip and when the entity was last seen; the motion estimator
+	// keeps the samples it needs itself.
+	RingBuffer<std::pair<double, cv::Rect>, 2> bbHistory;
+	MotionEstimator motion;
+	std::map<std::shared_ptr<const DetectionZone>, ulong> detections;
 
 	ulong id = 0;
 	ulong lastUpdateFrameId;
@@ -44,17 +50,13 @@ public:
 	cv::Rect dr;
 
 	Entity(cv::Rect &box, ulong lastUpdateFrameId);
-	~Entity();
 
 	cv::Rect deadRecon(double frameTime);
 	void assignId(ulong id);
 	void calculateVelocityBearing(double &vel, double &bearing, double pixelsPerMeter);
 	double getBearingRadians();
-	void update(cv::Rect *newBox, ulong frameId, double frameTime);
+	void update(cv::Rect *newBox, ulong frameId, double frameTime, MotionModel model);
 	std::string str();
-
-	private:
-	void calculateVelocity(cv::Rect &r1, cv::Rect &r2, double velocity[], double dt, double multiplier);
 };
 
 
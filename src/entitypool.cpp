@@ -0,0 +1,39 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include "entitypool.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+Entity *EntityPool::create(Rect &box, ulong frameId)
+{
+	Entity *e;
+	if ( spare.empty() ) {
+		storage.emplace_back(box, frameId);
+		e = &storage.back();
+	} else {
+		e = spare.back();
+		spare.pop_back();
+		*e = Entity(box, frameId);
+	}
+	live.push_back(e);
+	return e;
+}
@@ -0,0 +1,70 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef ENTITYPOOL_H
+#define ENTITYPOOL_H
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "entity.h"
+
+namespace cvqm {
+	class EntityPool;
+}
+
+/*
+ * The tracked entities, in the order they were created.  Entities are held
+ * in blocks that are never freed, so they keep their addresses, and slots
+ * of removed entities are reused for new ones, so that once the pool has
+ * grown to the busiest scene no more are allocated.
+ */
+class cvqm::EntityPool
+{
+private:
+	std::deque<Entity> storage;
+	std::vector<Entity*> live;
+	std::vector<Entity*> spare;
+
+public:
+	typedef std::vector<Entity*>::const_iterator const_iterator;
+
+	Entity *create(cv::Rect &box, ulong frameId);
+
+	// Removes the entities test(e) picks in a single pass, keeping the rest
+	// in order
+	template<typename F> void removeIf(F test)
+	{
+		auto kept = std::remove_if(live.begin(), live.end(), [&](Entity *e) {
+			if ( !test(e) )
+				return false;
+			spare.push_back(e);
+			return true;
+		});
+		live.erase(kept, live.end());
+	}
+
+	const_iterator begin() const { return live.begin(); }
+	const_iterator end() const { return live.end(); }
+	size_t size() const { return live.size(); }
+};
+
+#endif // ENTITYPOOL_H
@@ -0,0 +1,340 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "framedilator.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+namespace {
+	const char *const ENGINE_NAMES[] = { "ellipse", "rectangle", "octagon" };
+
+	// out = max(a, b), byte by byte.  out may be a or b.
+	void maxRows(uchar *out, const uchar *a, const uchar *b, int n)
+	{
+		int i = 0;
+#ifdef __SSE2__
+		for(; i + 16 <= n; i += 16) {
+			__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_max_epu8(va, vb));
+		}
+#endif
+		for(; i < n; i++)
+			out[i] = max(a[i], b[i]);
+	}
+
+	// out[i] = in[i - shift], and 0 where that is outside in
+	void shiftRow(uchar *out, const uchar *in, int shift, int n)
+	{
+		int s = min(n, abs(shift));
+		if ( shift >= 0 ) {
+			memset(out, 0, s);
+			memcpy(out + s, in, n - s);
+		} else {
+			memcpy(out, in + s, n - s);
+			memset(out + n - s, 0, s);
+		}
+	}
+}
+
+void FrameDilator::configure(DilateEngine engine, int factor)
+{
+	if ( engine == this->engine && factor == this->factor )
+		return;
+	this->engine = engine;
+	this->factor = factor;
+
+	passes.clear();
+	lineBefore = lineAfter = 0;
+	if ( engine == DILATE_ELLIPSE ) {
+		kernel = getStructuringElement(MORPH_ELLIPSE, Size(2*factor, 2*factor), Point(factor, factor));
+	} else if ( factor > 0 ) {
+		// Each diagonal spans 2k pixels each way, and the row and column the
+		// rest of the square, in the proportions of a regular octagon
+		int k = 0;
+		if ( engine == DILATE_OCTAGON )
+			k = min((factor - 1) / 2, static_cast<int>(lround((2*factor - 1) / (2 * (2 + sqrt(2.0))))));
+		lineBefore = factor - 2*k;
+		lineAfter = factor - 1 - 2*k;
+		passes.push_back(LinePass{lineBefore, lineAfter, 0});
+		if ( k > 0 ) {
+			passes.push_back(LinePass{k, k, 1});
+			passes.push_back(LinePass{k, k, -1});
+		}
+	}
+	buildShape();
+}
+
+void FrameDilator::buildShape()
+{
+	shapeRows.clear();
+	spans.clear();
+	if ( factor <= 0 )
+		return;
+
+	// Column span of each row of the shape, by offset from the anchor
+	vector<Range> rowSpans(2 * factor, Range(INT_MAX, INT_MIN));
+	if ( engine == DILATE_ELLIPSE ) {
+		for(int i=0; i < kernel.rows; i++) {
+			const uchar *k = kernel.ptr(i);
+			for(int j=0; j < kernel.cols; j++) {
+				if ( k[j] ) {
+					rowSpans[i].start = min(rowSpans[i].start, j - factor);
+					rowSpans[i].end = max(rowSpans[i].end, j - factor + 1);
+				}
+			}
+		}
+	} else {
+		// The row and column passes sweep a square, which each pair of
+		// diagonal steps (t, u) moves by (t - u, t + u)
+		int k = passes.size() > 1 ? passes[1].before : 0;
+		for(int t=-k; t <= k; t++) {
+			for(int u=-k; u <= k; u++) {
+				for(int dy=t + u - lineBefore; dy <= t + u + lineAfter; dy++) {
+					Range &r = rowSpans[dy + factor];
+					r.start = min(r.start, t - u - lineBefore);
+					r.end = max(r.end, t - u + lineAfter + 1);
+				}
+			}
+		}
+	}
+
+	int widest = 1;
+	int leftmost = 0;
+	for(int i=0; i < static_cast<int>(rowSpans.size()); i++) {
+		const Range &r = rowSpans[i];
+		if ( r.start >= r.end )
+			continue;
+		size_t span = find(spans.begin(), spans.end(), r) - spans.begin();
+		if ( span == spans.size() )
+			spans.push_back(r);
+		shapeRows.push_back(ShapeRow{i - factor, static_cast<int>(span)});
+		widest = max(widest, r.size());
+		leftmost = min(leftmost, r.start);
+	}
+	padWords = (63 - leftmost) / 64;
+	for(doublings = 0; (2 << doublings) <= widest; doublings++) {}
+}
+
+void FrameDilator::apply(const Mat &src, Mat &dst, const Range &rows)
+{
+	CV_Assert( src.size() == dst.size() && src.type() == dst.type() && src.depth() == CV_8U && src.data != dst.data );
+	if ( rows.empty() )
+		return;
+
+	if ( engine == DILATE_ELLIPSE ) {
+		Mat out = dst.rowRange(rows);
+		dilate(src.rowRange(rows), out, kernel);
+		return;
+	}
+
+	int channels = src.channels();
+	if ( passes.empty() ) {
+		for(int y=rows.start; y < rows.end; y++)
+			memcpy(dst.ptr(y), src.ptr(y), static_cast<size_t>(src.cols) * channels);
+		return;
+	}
+
+	// The rows each pass reads, worked back from the rows wanted
+	Range needed[4];
+	size_t count = passes.size();
+	needed[count] = rows;
+	for(size_t i=count; i-- > 0; )
+		needed[i] = Range(max(0, needed[i + 1].start - passes[i].before),
+						  min(src.rows, needed[i + 1].end + passes[i].after));
+
+	passInput.create(needed[0].size(), src.cols, src.type());
+	for(int y=needed[0].start; y < needed[0].end; y++)
+		dilateRow(src.ptr(y), passInput.ptr(y - needed[0].start), src.cols, channels);
+
+	for(size_t i=0; i < count; i++) {
+		if ( i + 1 == count ) {
+			linePass(passInput, needed[i].start, dst, 0, needed[i + 1], passes[i]);
+		} else {
+			passOutput.create(needed[i + 1].size(), src.cols, src.type());
+			linePass(passInput, needed[i].start, passOutput, needed[i + 1].start, needed[i + 1], passes[i]);
+			swap(passInput, passOutput);
+		}
+	}
+}
+
+void FrameDilator::apply(const BitMask &src, BitMask &dst, const Range &rows)
+{
+	CV_Assert( src.rows() == dst.rows() && src.cols() == dst.cols() && &src != &dst );
+	int words = src.wordsPerRow();
+	if ( rows.empty() || words == 0 )
+		return;
+	if ( shapeRows.empty() ) {
+		for(int y=rows.start; y < rows.end; y++)
+			memcpy(dst.row(y), src.row(y), words * sizeof(uint64_t));
+		return;
+	}
+
+	// Widen each row under the output rows by each span.  The doubled rows
+	// start padWords early, for the spans reaching left of the first column.
+	Range needed(max(0, rows.start + shapeRows.front().dy), min(src.rows(), rows.end + shapeRows.back().dy));
+	size_t rowWords = static_cast<size_t>(words);
+	int paddedWords = words + padWords;
+	size_t spanWords = needed.size() * rowWords;
+	doubled.resize((doublings + 1) * static_cast<size_t>(paddedWords));
+	widenedRows.resize(spans.size() * spanWords);
+	uint64_t tail = src.tailMask();
+	for(int y=needed.start; y < needed.end; y++) {
+		memset(doubled.data(), 0, padWords * sizeof(uint64_t));
+		memcpy(doubled.data() + padWords, src.row(y), rowWords * sizeof(uint64_t));
+		for(int level=1; level <= doublings; level++) {
+			const uint64_t *in = doubled.data() + (level - 1) * paddedWords;
+			uint64_t *out = doubled.data() + level * paddedWords;
+			for(int w=0; w < paddedWords; w++)
+				out[w] = in[w] | BitMask::shiftedWord(in, paddedWords, w, 1 << (level - 1));
+		}
+		for(size_t s=0; s < spans.size(); s++) {
+			// The span is covered by two overlapping power of two widths
+			int length = spans[s].size();
+			int level = 0;
+			while ( (2 << level) <= length )
+				level++;
+			const uint64_t *in = doubled.data() + level * paddedWords;
+			uint64_t *out = widenedRows.data() + s * spanWords + (y - needed.start) * rowWords;
+			int second = spans[s].end - (1 << level);
+			for(int w=0; w < words; w++)
+				out[w] = BitMask::shiftedWord(in, paddedWords, w + padWords, spans[s].start) |
+						 BitMask::shiftedWord(in, paddedWords, w + padWords, second);
+			out[words - 1] &= tail;
+		}
+	}
+
+	for(int y=rows.start; y < rows.end; y++) {
+		uint64_t *out = dst.row(y);
+		memset(out, 0, rowWords * sizeof(uint64_t));
+		for(const ShapeRow &r: shapeRows) {
+			int from = y + r.dy;
+			if ( from < needed.start || from >= needed.end )
+				continue;
+			const uint64_t *in = widenedRows.data() + r.span * spanWords + (from - needed.start) * rowWords;
+			for(int w=0; w < words; w++)
+				out[w] |= in[w];
+		}
+	}
+}
+
+void FrameDilator::dilateRow(const uchar *src, uchar *dst, int cols, int channels)
+{
+	// Along a row the window is widened by doubling, as each step is one
+	// vector max of the row with itself shifted, which is cheaper in
+	// practice than the running maxima below for any usable factor.  The
+	// result is the larger of two overlapping power of two windows.
+	int window = lineBefore + lineAfter + 1;
+	int length = (cols + window - 1) * channels;
+	line.assign(length, 0);
+	memcpy(line.data() + lineBefore * channels, src, static_cast<size_t>(cols) * channels);
+	widened.resize(length);
+
+	uchar *current = line.data();
+	uchar *next = widened.data();
+	int span = 1;
+	for(; span * 2 <= window; span *= 2) {
+		length -= span * channels;
+		maxRows(next, current, current + span * channels, length);
+		swap(current, next);
+	}
+	maxRows(dst, current, current + (window - span) * channels, cols * channels);
+}
+
+void FrameDilator::linePass(const Mat &src, int srcStart, Mat &dst, int dstStart, const Range &rows, const LinePass &pass)
+{
+	// Rows are split into blocks of one window's height, which are scanned
+	// forwards and backwards for their running maxima along the lines.  Any
+	// window spans at most two blocks, and is the larger of the backward
+	// maximum where it starts and the forward maximum where it ends.  The
+	// maxima are kept with enough columns either side for the lines that
+	// start or end outside the image.
+	int channels = src.channels();
+	int width = src.cols * channels;
+	int shift = pass.dx * channels;
+	int pad = pass.dx ? max(pass.before, pass.after) * channels : 0;
+	int stride = width + 2 * pad;
+	int window = pass.before + pass.after + 1;
+	int base = rows.start - pass.before;
+	int n = rows.size() + window - 1;
+	blockPrefix.create(n, stride, CV_8UC1);
+	blockSuffix.create(n, stride, CV_8UC1);
+
+	auto row = [&](int j) -> const uchar * {
+		int y = base + j - srcStart;
+		return y >= 0 && y < src.rows ? src.ptr(y) : nullptr;
+	};
+	auto start = [&](uchar *m, const uchar *s) {
+		memset(m, 0, stride);
+		if ( s )
+			memcpy(m + pad, s, width);
+	};
+	auto extend = [&](uchar *m, const uchar *previous, int by, const uchar *s) {
+		shiftRow(m, previous, by, stride);
+		if ( s )
+			maxRows(m + pad, m + pad, s, width);
+	};
+
+	for(int j=0; j < n; j++) {
+		if ( j % window == 0 )
+			start(blockPrefix.ptr(j), row(j));
+		else
+			extend(blockPrefix.ptr(j), blockPrefix.ptr(j - 1), shift, row(j));
+	}
+	for(int j=n - 1; j >= 0; j--) {
+		if ( (j + 1) % window == 0 || j == n - 1 )
+			start(blockSuffix.ptr(j), row(j));
+		else
+			extend(blockSuffix.ptr(j), blockSuffix.ptr(j + 1), -shift, row(j));
+	}
+
+	for(int y=rows.start; y < rows.end; y++) {
+		int first = y - rows.start;
+		const uchar *h = blockSuffix.ptr(first) + pad - pass.before * shift;
+		const uchar *g = blockPrefix.ptr(first + window - 1) + pad + pass.after * shift;
+		maxRows(dst.ptr(y - dstStart), h, g, width);
+	}
+}
+
+const char *FrameDilator::name(DilateEngine engine)
+{
+	return ENGINE_NAMES[engine];
+}
+
+bool FrameDilator::parse(const string &name, DilateEngine &engine)
+{
+	for(int i=DILATE_ELLIPSE; i <= DILATE_OCTAGON; i++) {
+		if ( name == ENGINE_NAMES[i] ) {
+			engine = static_cast<DilateEngine>(i);
+			return true;
+		}
+	}
+	return false;
+}
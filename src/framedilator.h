@@ -0,0 +1,115 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef FRAMEDILATOR_H
+#define FRAMEDILATOR_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "videoprocessordetectionsettings.h"
+#include "bitmask.h"
+
+namespace cvqm {
+	class FrameDilator;
+}
+
+/*
+ * Dilates the threshold masks, with the engine chosen by dilate_engine.
+ * Every engine covers the 2*factor square anchored at (factor, factor) that
+ * the ellipse kernel is drawn in.  The ellipse engine is OpenCV's, with the
+ * kernel kept until the factor changes, and costs more as the kernel grows.
+ * The rectangle and octagon engines are built from maxima along lines: the
+ * rectangle from a row and a column, and the octagon, which approximates
+ * the ellipse, from those and the two diagonals.  Columns and diagonals use
+ * the van Herk/Gil-Werman running maxima, at a constant number of
+ * comparisons per pixel whatever the factor, and rows double their window
+ * in log2(factor) vector passes.  Each line is clipped to the image in
+ * turn, so near the edges the octagon covers a little less than it would
+ * in one pass.
+ *
+ * Bit masks are dilated by the engine's whole shape in one pass, which at
+ * the image edges can differ from the octagon's line by line clipping.
+ * Each row of the mask is widened once for every distinct width of the
+ * shape's rows, by doubling with word shifts and ORs, and the widened rows
+ * under each output row are then ORed together.
+ *
+ * Rows can be dilated a range at a time, using the rows around the range,
+ * as dilate() does on a row range of a larger image.  Pixels outside the
+ * image do not contribute.  Working buffers are kept between calls.
+ */
+class cvqm::FrameDilator
+{
+private:
+	// A running maximum down the rows, moving dx columns for each row
+	struct LinePass {
+		int before;
+		int after;
+		int dx;
+	};
+
+	DilateEngine engine = DILATE_ELLIPSE;
+	int factor = -1;
+	cv::Mat kernel;
+	int lineBefore = 0;   // the horizontal pass's reach
+	int lineAfter = 0;
+	std::vector<LinePass> passes;
+
+	std::vector<uchar> line;         // a padded row, and its widened windows
+	std::vector<uchar> widened;
+	cv::Mat passInput;
+	cv::Mat passOutput;
+	cv::Mat blockPrefix;
+	cv::Mat blockSuffix;
+
+	// The shape's rows, as the row offset and the index of its column span
+	struct ShapeRow {
+		int dy;
+		int span;
+	};
+	std::vector<ShapeRow> shapeRows;
+	std::vector<cv::Range> spans;       // distinct column offsets, end exclusive
+	int doublings = 0;                  // widenings by doubling the widest span needs
+	int padWords = 0;                   // words the spans reach left of a row
+	std::vector<uint64_t> doubled;      // a bit row widened by 1, 2, 4... pixels
+	std::vector<uint64_t> widenedRows;  // each row widened by each span
+
+	void buildShape();
+
+	void dilateRow(const uchar *src, uchar *dst, int cols, int channels);
+	void linePass(const cv::Mat &src, int srcStart, cv::Mat &dst, int dstStart, const cv::Range &rows,
+				  const LinePass &pass);
+
+public:
+	void configure(DilateEngine engine, int factor);
+
+	// Dilates the given rows of src into the same rows of dst, which must
+	// already have src's size and type, and be a different image
+	void apply(const cv::Mat &src, cv::Mat &dst, const cv::Range &rows);
+	void apply(const BitMask &src, BitMask &dst, const cv::Range &rows);
+
+	// How many rows below a range are read to dilate it
+	int reach() const { return std::max(0, factor); }
+
+	static const char *name(DilateEngine engine);
+	static bool parse(const std::string &name, DilateEngine &engine);
+};
+
+#endif // FRAMEDILATOR_H
@@ -0,0 +1,82 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef FRAMEPACKET_H
+#define FRAMEPACKET_H
+
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+#include "videoprocessorsnapshot.h"
+#include "blobextractor.h"
+
+namespace cvqm {
+	struct FramePacket;
+}
+
+/*
+ * A frame in flight through the VideoProcessor pipeline, carrying the
+ * results of each stage to the next.  Packets are recycled, so their
+ * images and vectors keep their storage from one frame to the next.
+ */
+struct cvqm::FramePacket {
+	ulong frameId = 0;
+	double frameTime = 0;
+	double dFrameTime = 0;
+	std::chrono::steady_clock::time_point captureTime;
+
+	// Buffers (re)allocated while processing this frame
+	unsigned long bufferAllocations = 0;
+
+	// Fraction of the frame outside the processing region
+	double skippedPixels = 0;
+
+	// Milliseconds spent correlating rects with entities, and the fraction
+	// of the entities already tracked that a rect updated
+	double correlationTime = 0;
+	double updatedEntities = 0;
+
+	// Zones and settings in effect when the frame was captured
+	std::shared_ptr<const VideoProcessorSnapshot> snapshot;
+
+	// The frame as captured, and reduced to the processing resolution and
+	// colour mode.  Rects are at the capture resolution.
+	cv::Mat sourceFrame;
+	cv::Mat scaledFrame;
+	cv::Mat frame;
+
+	// Blobs are at the processing resolution, and their rects at the capture
+	// resolution.  Contours are only traced when the output is rendered.
+	std::vector<Blob> blobs;
+	std::vector<cv::Rect> rects;
+	std::vector<std::vector<cv::Point>> contours;
+	std::vector<cv::Vec4i> hierarchy;
+
+	// Intermediate images, retained for the debug windows
+	cv::Mat blurFrame;
+	cv::Mat delta;
+	cv::Mat thresholdedDelta;
+	cv::Mat dilatedDetection;
+	cv::Mat dilatedBlending;
+	cv::Mat background;
+};
+
+#endif // FRAMEPACKET_H
@@ -0,0 +1,395 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "framesmoother.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+namespace {
+	// Stack blur sums reach 255 * (radius + 1)^4, which must fit in an int
+	constexpr int MAX_STACK_RADIUS = 50;
+
+	const char *const ENGINE_NAMES[] = { "gaussian", "box", "stack", "integral" };
+
+	// Weights one row of a stack blur.  Each tap is weighted by radius + 1
+	// less its distance from the centre.  Moving the centre one pixel right
+	// lowers the weight of every tap at or left of it by one and raises the
+	// others, so the weighted sum is kept up to date from the sums of the
+	// two halves.  col maps each tap to its reflected column.
+	template<int CHANNELS>
+	void stackBlurRow(const uchar *row, int *out, const int *col, int cols, int radius)
+	{
+		for(int c=0; c < CHANNELS; c++) {
+			const uchar *p = row + c;
+			int *o = out + c;
+			int sum = 0, sumOut = 0, sumIn = 0;
+			for(int i=-radius; i <= radius; i++) {
+				int v = p[col[i] * CHANNELS];
+				sum += (radius + 1 - abs(i)) * v;
+				if ( i <= 0 )
+					sumOut += v;
+				else
+					sumIn += v;
+			}
+			for(int x=0; ; x++) {
+				o[x * CHANNELS] = sum;
+				if ( x + 1 == cols )
+					break;
+				int in = sumIn + p[col[x + radius + 1] * CHANNELS];
+				int centre = p[(x + 1) * CHANNELS];
+				sum += in - sumOut;
+				sumOut += centre - p[col[x - radius] * CHANNELS];
+				sumIn = in - centre;
+			}
+		}
+	}
+
+	// Moves the vertical stack blur window of every column down one row
+	void slideColumns(int *sum, int *sumOut, int *sumIn, const int *leaving, const int *entering,
+					  const int *centre, int width)
+	{
+		int k = 0;
+#ifdef __SSE2__
+		for(; k + 4 <= width; k += 4) {
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + k));
+			__m128i out = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sumOut + k));
+			__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sumIn + k));
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(centre + k));
+			s = _mm_sub_epi32(s, out);
+			out = _mm_sub_epi32(out, _mm_loadu_si128(reinterpret_cast<const __m128i*>(leaving + k)));
+			in = _mm_add_epi32(in, _mm_loadu_si128(reinterpret_cast<const __m128i*>(entering + k)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sum + k), _mm_add_epi32(s, in));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sumOut + k), _mm_add_epi32(out, c));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sumIn + k), _mm_sub_epi32(in, c));
+		}
+#endif
+		for(; k < width; k++) {
+			int in = sumIn[k] + entering[k];
+			sum[k] += in - sumOut[k];
+			sumOut[k] += centre[k] - leaving[k];
+			sumIn[k] = in - centre[k];
+		}
+	}
+
+	// Adds a row of pixels to per-column sums
+	void addRow(int *sum, const uchar *row, int width)
+	{
+		int k = 0;
+#ifdef __SSE2__
+		const __m128i zero = _mm_setzero_si128();
+		for(; k + 8 <= width; k += 8) {
+			__m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + k)), zero);
+			__m128i *s = reinterpret_cast<__m128i*>(sum + k);
+			_mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_unpacklo_epi16(v, zero)));
+			_mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(v, zero)));
+		}
+#endif
+		for(; k < width; k++)
+			sum[k] += row[k];
+	}
+
+	// Moves per-column sums down a row, adding the row entering the window
+	// and taking the one leaving it, either of which may be past the edge
+	void slideRow(int *sum, const uchar *entering, const uchar *leaving, int width)
+	{
+		if ( !leaving ) {
+			if ( entering )
+				addRow(sum, entering, width);
+			return;
+		}
+		int k = 0;
+		if ( entering ) {
+#ifdef __SSE2__
+			const __m128i zero = _mm_setzero_si128();
+			for(; k + 8 <= width; k += 8) {
+				__m128i in = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(entering + k)), zero);
+				__m128i out = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(leaving + k)), zero);
+				__m128i change = _mm_sub_epi16(in, out);
+				__m128i sign = _mm_srai_epi16(change, 15);
+				__m128i *s = reinterpret_cast<__m128i*>(sum + k);
+				_mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_unpacklo_epi16(change, sign)));
+				_mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(change, sign)));
+			}
+#endif
+			for(; k < width; k++)
+				sum[k] += entering[k] - leaving[k];
+		} else {
+			for(; k < width; k++)
+				sum[k] -= leaving[k];
+		}
+	}
+
+	// Sums a row of column sums over a window of before + 1 + after pixels,
+	// clipped at the ends of the row, as the difference of two running
+	// totals along it.  The totals are kept in prefix, (cols + 1) pixels long.
+	template<int CHANNELS>
+	void windowRow(int *out, int *prefix, const int *sum, int cols, int before, int after)
+	{
+		int width = cols * CHANNELS;
+		int k = 0;
+		for(int c=0; c < CHANNELS; c++)
+			prefix[c] = 0;
+#ifdef __SSE2__
+		if ( CHANNELS == 1 ) {
+			// Four totals at a time, each lane adding those to its left
+			__m128i carry = _mm_setzero_si128();
+			for(; k + 4 <= width; k += 4) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + k));
+				v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+				v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+				v = _mm_add_epi32(v, carry);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(prefix + k + 1), v);
+				carry = _mm_shuffle_epi32(v, 0xFF);
+			}
+		}
+#endif
+		for(; k < width; k++)
+			prefix[k + CHANNELS] = prefix[k] + sum[k];
+
+		// Pixels whose window lies wholly inside the row
+		int inner0 = min(before, cols) * CHANNELS;
+		int inner1 = max(inner0, (cols - after) * CHANNELS);
+		int ahead = (after + 1) * CHANNELS;
+		int behind = before * CHANNELS;
+		k = inner0;
+#ifdef __SSE2__
+		for(; k + 4 <= inner1; k += 4) {
+			__m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix + k + ahead));
+			__m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix + k - behind));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm_sub_epi32(last, first));
+		}
+#endif
+		for(; k < inner1; k++)
+			out[k] = prefix[k + ahead] - prefix[k - behind];
+		for(k=0; k < inner0; k++)
+			out[k] = prefix[min(cols, k / CHANNELS + after + 1) * CHANNELS + k % CHANNELS] - prefix[k % CHANNELS];
+		for(k=inner1; k < width; k++)
+			out[k] = prefix[width + k % CHANNELS] - prefix[max(0, k / CHANNELS - before) * CHANNELS + k % CHANNELS];
+	}
+
+	// Normalises a row of sums to pixels, rounding to nearest
+	void scaleRow(uchar *out, const int *sum, float scale, int width)
+	{
+		int k = 0;
+#ifdef __SSE2__
+		const __m128 factor = _mm_set1_ps(scale);
+		for(; k + 8 <= width; k += 8) {
+			__m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + k))), factor));
+			__m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + k + 4))), factor));
+			__m128i packed = _mm_packs_epi32(lo, hi);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out + k), _mm_packus_epi16(packed, packed));
+		}
+#endif
+		for(; k < width; k++)
+			out[k] = cv::saturate_cast<uchar>(sum[k] * scale);
+	}
+}
+
+void FrameSmoother::configure(BlurEngine engine, int kernelSize, double stdev)
+{
+	this->engine = engine;
+	this->kernelSize = max(1, kernelSize);
+	this->stdev = stdev;
+	if ( engine == BLUR_STACK )
+		this->kernelSize = min(this->kernelSize, 2 * MAX_STACK_RADIUS + 1);
+}
+
+void FrameSmoother::apply(const Mat &src, Mat &dst, const Range &rows)
+{
+	CV_Assert( src.size() == dst.size() && src.type() == dst.type() && src.depth() == CV_8U );
+	CV_Assert( src.data != dst.data || (rows.start == 0 && rows.end == src.rows) );
+	if ( rows.empty() )
+		return;
+
+	// OpenCV only filters 8 bit images in fixed point when they are not
+	// views into a larger image, or their border is isolated; otherwise it
+	// falls back to floating point, which rounds differently
+	int border = BORDER_REFLECT_101 | BORDER_ISOLATED;
+	Size kernel(kernelSize, kernelSize);
+	bool whole = rows.start == 0 && rows.end == src.rows;
+
+	switch ( engine ) {
+	case BLUR_STACK:
+	case BLUR_INTEGRAL:
+		// These read source rows they have already written, when filtering in place
+		if ( src.data == dst.data ) {
+			src.copyTo(aliasCopy);
+			apply(aliasCopy, dst, rows);
+		} else if ( engine == BLUR_STACK ) {
+			stackBlur(src, dst, rows);
+		} else {
+			integralMean(src, dst, rows);
+		}
+		break;
+	default:
+		if ( whole ) {
+			if ( engine == BLUR_BOX )
+				blur(src, dst, kernel, Point(-1, -1), border);
+			else
+				GaussianBlur(src, dst, kernel, stdev, 0, border);
+		} else {
+			// The rows are filtered as an image of their own, with a halo of
+			// the real rows around them, and the halo is dropped
+			int halo = kernelSize / 2;
+			Range band(max(0, rows.start - halo), min(src.rows, rows.end + halo));
+			if ( engine == BLUR_BOX )
+				blur(src.rowRange(band), bandOut, kernel, Point(-1, -1), border);
+			else
+				GaussianBlur(src.rowRange(band), bandOut, kernel, stdev, 0, border);
+			Mat out = dst.rowRange(rows);
+			bandOut.rowRange(rows.start - band.start, rows.end - band.start).copyTo(out);
+		}
+		break;
+	}
+}
+
+void FrameSmoother::stackBlur(const Mat &src, Mat &dst, const Range &rows)
+{
+	int radius = kernelSize / 2;
+	int channels = src.channels();
+	int width = src.cols * channels;
+	int taps = 2 * radius + 2; // one spare slot for the row entering the window
+
+	columns.resize(src.cols + 2 * radius + 1);
+	for(int i=-radius; i <= src.cols + radius; i++)
+		columns[i + radius] = borderInterpolate(i, src.cols, BORDER_REFLECT_101);
+	rowSums.resize(static_cast<size_t>(taps) * width);
+	columnSums.assign(3 * static_cast<size_t>(width), 0);
+
+	// Rows are weighted horizontally once, into a ring of the rows in the
+	// vertical window, which then slides down the same way
+	int first = rows.start - radius;
+	auto slot = [&](int y) { return rowSums.data() + static_cast<size_t>((y - first) % taps) * width; };
+	const int *col = columns.data() + radius;
+	auto load = [&](int y) {
+		int *sums = slot(y);
+		const uchar *row = src.ptr(borderInterpolate(y, src.rows, BORDER_REFLECT_101));
+		switch ( channels ) {
+		case 1: stackBlurRow<1>(row, sums, col, src.cols, radius); break;
+		case 3: stackBlurRow<3>(row, sums, col, src.cols, radius); break;
+		default: CV_Error(Error::StsUnsupportedFormat, "FrameSmoother: stack blur needs 1 or 3 channels");
+		}
+		return sums;
+	};
+
+	int *sum = columnSums.data();
+	int *sumOut = sum + width;
+	int *sumIn = sumOut + width;
+	for(int i=-radius; i <= radius; i++) {
+		const int *h = load(rows.start + i);
+		int weight = radius + 1 - abs(i);
+		for(int k=0; k < width; k++) {
+			sum[k] += weight * h[k];
+			if ( i <= 0 )
+				sumOut[k] += h[k];
+			else
+				sumIn[k] += h[k];
+		}
+	}
+
+	int weights = (radius + 1) * (radius + 1);
+	float scale = 1.0f / (static_cast<float>(weights) * weights);
+	for(int y=rows.start; ; y++) {
+		scaleRow(dst.ptr(y), sum, scale, width);
+		if ( y + 1 == rows.end )
+			break;
+		const int *leaving = slot(y - radius);
+		const int *entering = load(y + radius + 1);
+		slideColumns(sum, sumOut, sumIn, leaving, entering, slot(y + 1), width);
+	}
+}
+
+void FrameSmoother::integralMean(const Mat &src, Mat &dst, const Range &rows)
+{
+	int before = kernelSize / 2;
+	int after = kernelSize - 1 - before;
+	int channels = src.channels();
+	int width = src.cols * channels;
+	if ( channels != 1 && channels != 3 )
+		CV_Error(Error::StsUnsupportedFormat, "FrameSmoother: integral mean needs 1 or 3 channels");
+
+	columnScale.resize(src.cols);
+	for(int x=0; x < src.cols; x++)
+		columnScale[x] = 1.0f / (min(src.cols, x + after + 1) - max(0, x - before));
+
+	// Columns whose window lies wholly inside the row share one scale
+	int inner0 = min(before, src.cols);
+	int inner1 = max(inner0, src.cols - after);
+	float innerScale = 1.0f / kernelSize;
+
+	// Column sums over the window of the first row, which then slides down
+	// a row at a time; each row is summed along the window from them
+	columnSums.assign(width, 0);
+	int *sum = columnSums.data();
+	rowSums.resize(width);
+	int *window = rowSums.data();
+	prefixSums.resize(width + channels);
+	for(int y=max(0, rows.start - before); y < min(src.rows, rows.start + after + 1); y++)
+		addRow(sum, src.ptr(y), width);
+
+	for(int y=rows.start; ; y++) {
+		if ( channels == 1 )
+			windowRow<1>(window, prefixSums.data(), sum, src.cols, before, after);
+		else
+			windowRow<3>(window, prefixSums.data(), sum, src.cols, before, after);
+
+		float rowScale = 1.0f / (min(src.rows, y + after + 1) - max(0, y - before));
+		uchar *out = dst.ptr(y);
+		scaleRow(out + inner0 * channels, window + inner0 * channels, innerScale * rowScale, (inner1 - inner0) * channels);
+		auto clipped = [&](int x0, int x1) {
+			for(int x=x0; x < x1; x++) {
+				float scale = columnScale[x] * rowScale;
+				for(int c=0; c < channels; c++)
+					out[x * channels + c] = saturate_cast<uchar>(window[x * channels + c] * scale);
+			}
+		};
+		clipped(0, inner0);
+		clipped(inner1, src.cols);
+
+		if ( y + 1 == rows.end )
+			break;
+		slideRow(sum, y + after + 1 < src.rows ? src.ptr(y + after + 1) : nullptr,
+				 y - before >= 0 ? src.ptr(y - before) : nullptr, width);
+	}
+}
+
+const char *FrameSmoother::name(BlurEngine engine)
+{
+	return ENGINE_NAMES[engine];
+}
+
+bool FrameSmoother::parse(const string &name, BlurEngine &engine)
+{
+	for(int i=BLUR_GAUSSIAN; i <= BLUR_INTEGRAL; i++) {
+		if ( name == ENGINE_NAMES[i] ) {
+			engine = static_cast<BlurEngine>(i);
+			return true;
+		}
+	}
+	return false;
+}
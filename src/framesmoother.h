@@ -0,0 +1,77 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef FRAMESMOOTHER_H
+#define FRAMESMOOTHER_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "videoprocessordetectionsettings.h"
+
+namespace cvqm {
+	class FrameSmoother;
+}
+
+/*
+ * Smooths frames before they are differenced, with the engine chosen by
+ * blur_engine.  The Gaussian and box engines are OpenCV's; the stack and
+ * integral engines are implemented here.  All of them cost a constant amount
+ * per pixel except the Gaussian, which grows with blur_radius.
+ *
+ * Rows can be smoothed a range at a time; rows outside the range are used
+ * as neighbours, and the borders of src reflect without repeating the edge
+ * pixel, as with BORDER_REFLECT_101, so the result is the same to the bit
+ * whatever the ranges, and whether or not src is a view into a larger
+ * image.  Pixels beyond src are never read.  The integral engine instead
+ * shrinks its window at the edges.  Working buffers are kept between calls.
+ */
+class cvqm::FrameSmoother
+{
+private:
+	BlurEngine engine = BLUR_GAUSSIAN;
+	int kernelSize = 1;
+	double stdev = 0;
+
+	std::vector<int> columns;        // reflected or clipped columns of each window
+	std::vector<float> columnScale;  // reciprocal of each clipped window width
+	std::vector<int> rowSums;        // horizontally weighted rows, a ring of stack blur taps
+	std::vector<int> columnSums;     // per-column running sums for the vertical pass
+	std::vector<int> prefixSums;     // running totals along a row of column sums
+	cv::Mat aliasCopy;
+	cv::Mat bandOut;                 // a range and its halo, filtered by OpenCV
+
+	void stackBlur(const cv::Mat &src, cv::Mat &dst, const cv::Range &rows);
+	void integralMean(const cv::Mat &src, cv::Mat &dst, const cv::Range &rows);
+
+public:
+	void configure(BlurEngine engine, int kernelSize, double stdev);
+
+	// Smooths the given rows of src into the same rows of dst, which must
+	// already have src's size and type.  src and dst may be the same Mat
+	// only when all of its rows are smoothed in one call, as a later range
+	// would otherwise read rows an earlier one had already smoothed.
+	void apply(const cv::Mat &src, cv::Mat &dst, const cv::Range &rows);
+
+	static const char *name(BlurEngine engine);
+	static bool parse(const std::string &name, BlurEngine &engine);
+};
+
+#endif // FRAMESMOOTHER_H
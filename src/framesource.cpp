@@ -0,0 +1,105 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "framesource.h"
+
+using namespace std;
+using namespace cv;
+using namespace cvqm;
+
+FrameSource::~FrameSource() {}
+
+CameraFrameSource::CameraFrameSource(int deviceId, int xRes, int yRes) :
+	cap(deviceId),
+	deviceId(deviceId)
+{
+	cap.set(CV_CAP_PROP_FRAME_WIDTH, xRes);
+	cap.set(CV_CAP_PROP_FRAME_HEIGHT, yRes);
+
+	if(!cap.isOpened()) {
+		string err = "Unable to open " + to_string(deviceId);
+		throw invalid_argument(err);
+	}
+}
+
+bool CameraFrameSource::read(Mat &frame, double &frameTime)
+{
+	if ( !cap.read(frame) || frame.empty() )
+		throw runtime_error("Lost capture device " + to_string(this->deviceId));
+
+	auto t1 = chrono::system_clock::now();
+	if ( !started ) {
+		t0 = t1;
+		started = true;
+	}
+	chrono::duration<double> frameTimeDuration = t1-t0;
+	frameTime = frameTimeDuration.count();
+	return true;
+}
+
+VideoFileFrameSource::VideoFileFrameSource(const string &path, double nominalFps) :
+	cap(path),
+	nominalFps(nominalFps),
+	useNominalRate(nominalFps > 0)
+{
+	if(!cap.isOpened())
+		throw invalid_argument("Unable to open " + path);
+
+	if ( this->nominalFps <= 0 ) {
+		// Only used to step over frames whose timestamps do not advance
+		double containerFps = cap.get(CV_CAP_PROP_FPS);
+		this->nominalFps = containerFps > 0 ? containerFps : DEFAULT_FPS;
+	}
+}
+
+bool VideoFileFrameSource::read(Mat &frame, double &frameTime)
+{
+	if ( !cap.read(frame) || frame.empty() )
+		return false;
+
+	double step = 1.0 / this->nominalFps;
+	double containerTime = cap.get(CV_CAP_PROP_POS_MSEC) / 1000.0;
+	bool advanced = containerTime > this->lastContainerTime;
+	if ( advanced )
+		this->lastContainerTime = containerTime;
+
+	if ( this->useNominalRate ) {
+		frameTime = this->frameIndex / this->nominalFps;
+	} else if ( this->lastFrameTime < 0 ) {
+		frameTime = max(0.0, containerTime);
+	} else if ( advanced && containerTime > this->lastFrameTime ) {
+		frameTime = containerTime;
+	} else if ( advanced ) {
+		// Still behind the time given to a stalled frame; close in on the
+		// container by half steps rather than running a frame ahead of it
+		frameTime = this->lastFrameTime + step / 2;
+	} else {
+		// Duplicated or reordered timestamps, and sources such as image
+		// sequences that report no position, move on a nominal frame from
+		// the last time given, so the time never runs backwards
+		frameTime = this->lastFrameTime + step;
+	}
+	this->frameIndex++;
+	this->lastFrameTime = frameTime;
+	return true;
+}
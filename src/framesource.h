@@ -0,0 +1,85 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <string>
+#include <chrono>
+#include <opencv2/opencv.hpp>
+
+namespace cvqm {
+	class FrameSource;
+	class CameraFrameSource;
+	class VideoFileFrameSource;
+}
+
+/*
+ * Supplies frames and their timestamps (in seconds from the first frame) to
+ * the VideoProcessor.  read() returns false once the source is exhausted.
+ */
+class cvqm::FrameSource
+{
+public:
+	virtual bool read(cv::Mat &frame, double &frameTime) = 0;
+	virtual ~FrameSource();
+};
+
+/*
+ * Live capture device, timestamped with the wall clock at capture.
+ */
+class cvqm::CameraFrameSource : public cvqm::FrameSource
+{
+private:
+	cv::VideoCapture cap;
+	int deviceId;
+	std::chrono::system_clock::time_point t0;
+	bool started = false;
+
+public:
+	CameraFrameSource(int deviceId, int xRes, int yRes);
+	bool read(cv::Mat &frame, double &frameTime) override;
+};
+
+/*
+ * Recorded video file or image sequence (e.g. "frames/%05d.png").  Frames
+ * are delivered as fast as they are requested and timestamped from the
+ * container, or at a fixed nominal rate when nominalFps is non-zero.  A
+ * frame whose container timestamp fails to advance, as with duplicated or
+ * reordered timestamps or an image sequence, is timed a nominal frame after
+ * the one before it, so frame times only ever increase.
+ */
+class cvqm::VideoFileFrameSource : public cvqm::FrameSource
+{
+private:
+	cv::VideoCapture cap;
+	double nominalFps;
+	unsigned long frameIndex = 0;
+	double lastFrameTime = -1;
+	double lastContainerTime = -1;
+	bool useNominalRate;
+
+public:
+	static constexpr double DEFAULT_FPS = 25.0;
+
+	VideoFileFrameSource(const std::string &path, double nominalFps = 0);
+	bool read(cv::Mat &frame, double &frameTime) override;
+};
+
+#endif // FRAMESOURCE_H
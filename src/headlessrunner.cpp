@@ -0,0 +1,240 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <ctime>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+
+#include "headlessrunner.h"
+#include "enginecomparison.h"
+#include "multicameraengine.h"
+#include "backgroundblender.h"
+
+using namespace std;
+using namespace cv;
+using namespace cvqm;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleInterrupt(int)
+{
+	interrupted = 1;
+}
+
+HeadlessRunner::Camera::Camera(HeadlessRunner *runner, const EngineConfiguration &config) :
+	runner(runner),
+	name(config.name),
+	streamTimestamps(!config.inputFile.empty())
+{
+	configure(p, config);
+	p.detectionObserver = this;
+}
+
+void HeadlessRunner::Camera::detected(const DetectionZone *zone, Entity *e, Mat &)
+{
+	double dir, vel;
+	e->calculateVelocityBearing(vel, dir, zone->pixelsPerMeter);
+
+	// Recorded input is logged by position in the stream, not by wall clock
+	char timestamp[32];
+	if ( this->streamTimestamps ) {
+		double t = e->bbHistory.empty() ? 0 : e->bbHistory.front().first;
+		snprintf(timestamp, sizeof(timestamp), "%.3f", t);
+	} else {
+		time_t now = time(nullptr);
+		strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+	}
+
+	lock_guard<mutex> outputLock(runner->outputMutex);
+	*runner->out << timestamp << "," << this->name << "," << zone->name << "," << e->id << "," << vel << "," << dir << endl;
+}
+
+void HeadlessRunner::configure(VideoProcessor &p, const EngineConfiguration &config)
+{
+	p.setDeviceId(config.deviceId);
+	p.setResolution(config.xRes, config.yRes);
+	if ( !config.inputFile.empty() )
+		p.setInputFile(config.inputFile, config.inputFps);
+	VideoProcessorDetectionSettings settings = config.settings;
+	p.setCurrentConfiguration(&settings);
+	for(const DetectionZone &z: config.detectionZones)
+		p.addDetectionZone(z);
+	for(const Rect &r: config.maskZones)
+		p.addMaskZone(r);
+	for(const vector<Point> &polygon: config.maskPolygons)
+		p.addMaskPolygon(polygon);
+}
+
+HeadlessRunner::HeadlessRunner(const vector<EngineConfiguration> &configs, const string &outputPath, unsigned threadCount) :
+	threadCount(threadCount)
+{
+	bool writeHeader = true;
+	if ( outputPath.empty() || outputPath == "-" ) {
+		this->out = &cout;
+	} else {
+		writeHeader = !ifstream(outputPath).good(); // don't repeat the header when appending
+		this->file.open(outputPath, ios::out | ios::app);
+		if ( !this->file.is_open() )
+			throw invalid_argument("HeadlessRunner: unable to open " + outputPath);
+		this->out = &this->file;
+	}
+	if ( writeHeader )
+		*this->out << "time,camera,zone,entity,velocity_kmh,direction_deg" << endl;
+
+	for(const EngineConfiguration &config: configs)
+		cameras.push_back(unique_ptr<Camera>(new Camera(this, config)));
+}
+
+HeadlessRunner::~HeadlessRunner() = default;
+
+int HeadlessRunner::run()
+{
+	// A single camera runs its own pipeline threads; several cameras share
+	// a worker pool
+	unique_ptr<MultiCameraEngine> engine;
+	if ( cameras.size() > 1 ) {
+		engine.reset(new MultiCameraEngine(threadCount));
+		for(unique_ptr<Camera> &c: cameras)
+			engine->addCamera(c->name, &c->p);
+	}
+
+	cerr << "Background blending: " << BackgroundBlender::implementation() << endl;
+
+	auto t0 = chrono::steady_clock::now();
+	exception_ptr failure;
+	thread worker([this, &engine, &failure]() {
+		try {
+			if ( engine )
+				engine->run(cerr, REPORT_INTERVAL);
+			else
+				cameras.front()->p.run();
+		} catch (...) {
+			failure = current_exception();
+		}
+		interrupted = 1;
+	});
+
+	while ( !interrupted )
+		this_thread::sleep_for(chrono::milliseconds(100));
+	for(unique_ptr<Camera> &c: cameras)
+		c->p.requestShutdown();
+	worker.join();
+
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+	for(unique_ptr<Camera> &c: cameras) {
+		VideoProcessorStatistics st = c->p.getStatistics();
+		cerr << c->name << ": processed " << st.frames << " frames in " << elapsed.count() << " s ("
+			 << st.frames / elapsed.count() << " fps), mean latency " << st.latency << " ms, "
+			 << st.bufferAllocations << " buffer allocations, "
+			 << 100 * st.skippedPixels << "% of pixels skipped, correlation " << st.correlationTime << " ms, "
+			 << 100 * st.updatedEntities << "% of entities updated" << endl;
+	}
+
+	if ( failure ) {
+		try {
+			rethrow_exception(failure);
+		} catch (const exception &e) {
+			cerr << "Caught exception in VideoProcessor::run(): " << e.what() << endl;
+		} catch (...) {
+			cerr << "Caught exception in VideoProcessor::run(): catch-all" << endl;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+int HeadlessRunner::main(int argc, char *argv[])
+{
+	vector<string> configPaths;
+	string outputPath;
+	string inputPath;
+	double inputFps = -1;  // as configured unless given
+	int threadCount = 0;
+	vector<string> changes;
+	bool requireIdentical = false;
+	bool valid = true;
+	for(int i=1; i<argc && valid; i++) {
+		string arg = argv[i];
+		if ( arg == "--headless" && i+1 < argc ) {
+			configPaths.push_back(argv[++i]);
+		} else if ( arg == "--output" && i+1 < argc ) {
+			outputPath = argv[++i];
+		} else if ( arg == "--input" && i+1 < argc ) {
+			inputPath = argv[++i];
+		} else if ( arg == "--fps" && i+1 < argc ) {
+			inputFps = atof(argv[++i]);
+			valid = inputFps >= 0;
+		} else if ( arg == "--threads" && i+1 < argc ) {
+			threadCount = atoi(argv[++i]);
+		} else if ( arg == "--compare" && i+1 < argc ) {
+			changes.push_back(argv[++i]);
+		} else if ( arg == "--identical" ) {
+			requireIdentical = true;
+		} else {
+			valid = false;
+		}
+	}
+	bool comparing = !changes.empty();
+	if ( !valid || configPaths.empty() || threadCount < 0 || ((!inputPath.empty() || inputFps >= 0) && configPaths.size() > 1) ||
+		 (comparing && configPaths.size() > 1) || (requireIdentical && !comparing) ) {
+		cerr << "Usage: " << argv[0] << " --headless <config file> [--headless <config file> ...]"
+			 << " [--output <detections file>] [--threads <worker threads>]"
+			 << " [--input <video file or image sequence> [--fps <nominal fps>]]" << endl
+			 << "       " << argv[0] << " --headless <config file> [--input <video file or image sequence> [--fps <nominal fps>]]"
+			 << " --compare <setting>=<value> [--compare <setting>=<value> ...] [--identical] [--output <comparison file>]" << endl
+			 << "--input, --fps and --compare may only be given with a single configuration file." << endl;
+		return 2;
+	}
+
+	signal(SIGINT, handleInterrupt);
+	signal(SIGTERM, handleInterrupt);
+
+	try {
+		vector<EngineConfiguration> configs;
+		for(const string &path: configPaths)
+			configs.push_back(EngineConfiguration::load(path));
+		if ( !inputPath.empty() )
+			configs.front().inputFile = inputPath;
+		if ( inputFps >= 0 )
+			configs.front().inputFps = inputFps;
+		if ( comparing ) {
+			// A recording run twice, with the settings as loaded and as changed
+			EngineComparison comparison(configs.front(), changes);
+			ofstream file;
+			if ( !outputPath.empty() && outputPath != "-" ) {
+				file.open(outputPath);
+				if ( !file.is_open() )
+					throw invalid_argument("HeadlessRunner: unable to open " + outputPath);
+			}
+			unsigned long differing = comparison.run(file.is_open() ? file : cout, cerr);
+			return requireIdentical && differing > 0 ? 3 : 0;
+		}
+		HeadlessRunner runner(configs, outputPath, static_cast<unsigned>(threadCount));
+		return runner.run();
+	} catch (const exception &e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+}
@@ -0,0 +1,77 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <ostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "videoprocessor.h"
+#include "engineconfiguration.h"
+
+namespace cvqm {
+	class HeadlessRunner;
+}
+
+/*
+ * Drives one or more VideoProcessors from the command line without any Qt
+ * widgets.  No output image observer is attached, so the overlay rendering
+ * path is never taken; detections are written as CSV lines to stdout or a
+ * file.  Several cameras share one MultiCameraEngine worker pool.
+ */
+class cvqm::HeadlessRunner
+{
+private:
+	class Camera : public cvqm::DetectionObserver {
+	public:
+		HeadlessRunner *runner;
+		std::string name;
+		bool streamTimestamps;
+		VideoProcessor p;
+
+		Camera(HeadlessRunner *runner, const EngineConfiguration &config);
+		void detected(const DetectionZone *zone, Entity *e, cv::Mat &frame) override;
+	};
+
+	std::vector<std::unique_ptr<Camera>> cameras;
+	unsigned threadCount;
+	std::mutex outputMutex;
+	std::ofstream file;
+	std::ostream *out;
+
+	static constexpr double REPORT_INTERVAL = 10.0;
+
+public:
+	HeadlessRunner(const std::vector<EngineConfiguration> &configs, const std::string &outputPath, unsigned threadCount = 0);
+	~HeadlessRunner();
+
+	int run();
+
+	// Applies a configuration's input, settings and zones to a processor
+	static void configure(VideoProcessor &p, const EngineConfiguration &config);
+
+	static int main(int argc, char *argv[]);
+};
+
+#endif // HEADLESSRUNNER_H
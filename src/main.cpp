@@ -18,12 +18,17 @@
  ************************************************************************/
 
 #include <QApplication>
+#include <cstring>
 
 #include "mainwindow.h"
 #include "videoprocessor.h"
+#include "headlessrunner.h"
 
 int  main(int argc, char *argv[])
 {
+    if ( argc > 1 && strcmp(argv[1], "--headless") == 0 )
+        return cvqm::HeadlessRunner::main(argc, argv);
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
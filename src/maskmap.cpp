@@ -0,0 +1,92 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include "maskmap.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+namespace {
+	// Fractional bits of the scaled polygon vertices
+	constexpr int POLYGON_SHIFT = 8;
+}
+
+bool MaskMap::current(const VideoProcessorSnapshot &snapshot, Size size, int scale) const
+{
+	return !bitmap.empty() && bitmap.size() == size && this->scale == scale && this->version == snapshot.version;
+}
+
+void MaskMap::build(const VideoProcessorSnapshot &snapshot, Size size, int scale)
+{
+	this->version = snapshot.version;
+	this->scale = scale;
+
+	bitmap.create(size, CV_8UC1);
+	bitmap.setTo(Scalar(0));
+	Rect frameRect(Point(0, 0), size);
+	rects.clear();
+	for(const Rect &z: snapshot.maskZones) {
+		Rect r(Point(z.x / scale, z.y / scale),
+			   Point((z.x + z.width + scale - 1) / scale, (z.y + z.height + scale - 1) / scale));
+		rects.push_back(r & frameRect);
+		rectangle(bitmap, rects.back(), Scalar(255), FILLED);
+	}
+
+	// Scaled in fixed point, so fillPoly places the edges exactly
+	vector<vector<Point>> polygons(snapshot.maskPolygons.size());
+	for(size_t i=0; i < polygons.size(); i++)
+		for(const Point &p: snapshot.maskPolygons[i])
+			polygons[i].push_back(Point((p.x << POLYGON_SHIFT) / scale, (p.y << POLYGON_SHIFT) / scale));
+	if ( !polygons.empty() )
+		fillPoly(bitmap, polygons, Scalar(255), LINE_8, POLYGON_SHIFT);
+
+	spans.clear();
+	rowSpans.resize(size.height + 1);
+	for(int y=0; y < size.height; y++) {
+		rowSpans[y] = spans.size();
+		const uchar *row = bitmap.ptr(y);
+		int x = 0;
+		while ( x < size.width ) {
+			while ( x < size.width && row[x] )
+				x++;
+			int start = x;
+			while ( x < size.width && !row[x] )
+				x++;
+			if ( x > start )
+				spans.push_back(Range(start, x));
+		}
+	}
+	rowSpans[size.height] = spans.size();
+}
+
+bool MaskMap::rowMasked(int y, int x0, int x1) const
+{
+	bool masked = true;
+	forEachSpan(y, x0, x1, [&masked](int, int) { masked = false; });
+	return masked;
+}
+
+size_t MaskMap::unmaskedPixels(const Rect &region) const
+{
+	size_t count = 0;
+	for(int y=region.y; y < region.br().y; y++)
+		forEachSpan(y, region.x, region.br().x, [&count](int start, int end) { count += end - start; });
+	return count;
+}
@@ -0,0 +1,72 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef MASKMAP_H
+#define MASKMAP_H
+
+#include <vector>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+
+#include "videoprocessorsnapshot.h"
+
+namespace cvqm {
+	class MaskMap;
+}
+
+/*
+ * The mask zones and polygons of a snapshot, rasterized at the processing
+ * resolution.  Rebuilt only when the snapshot or frame size changes, and
+ * kept both as a bitmap, for display, and as the unmasked column spans of
+ * each row, which the per-pixel stages walk to skip masked pixels.
+ * Zones are rounded outwards when the frame is scaled down.
+ */
+class cvqm::MaskMap
+{
+private:
+	unsigned long version = 0;
+	int scale = 0;
+	cv::Mat bitmap;                 // 255 where masked
+	std::vector<cv::Range> spans;   // unmasked column spans, row by row
+	std::vector<size_t> rowSpans;   // index of each row's first span, then the end
+	std::vector<cv::Rect> rects;    // the rectangular zones
+
+public:
+	// Whether the map was built from this snapshot's zones at this size and scale
+	bool current(const VideoProcessorSnapshot &snapshot, cv::Size size, int scale) const;
+	void build(const VideoProcessorSnapshot &snapshot, cv::Size size, int scale);
+
+	// Calls f(start, end) for each unmasked span of row y between columns x0 and x1
+	template<typename F> void forEachSpan(int y, int x0, int x1, F f) const
+	{
+		for(size_t i = rowSpans[y]; i < rowSpans[y + 1]; i++) {
+			int start = std::max(spans[i].start, x0);
+			int end = std::min(spans[i].end, x1);
+			if ( start < end )
+				f(start, end);
+		}
+	}
+	bool rowMasked(int y, int x0, int x1) const;
+	size_t unmaskedPixels(const cv::Rect &region) const;
+
+	const cv::Mat &image() const { return bitmap; }
+	const std::vector<cv::Rect> &maskRects() const { return rects; }
+};
+
+#endif // MASKMAP_H
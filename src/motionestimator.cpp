@@ -0,0 +1,173 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include "motionestimator.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+namespace {
+	const char *const MODEL_NAMES[] = { "average", "least_squares", "kalman" };
+}
+
+void MotionEstimator::Axis::start(double z)
+{
+	p = z;
+	v = 0;
+	pp = KALMAN_POSITION_NOISE * KALMAN_POSITION_NOISE;
+	pv = 0;
+	vv = KALMAN_INITIAL_VELOCITY_NOISE * KALMAN_INITIAL_VELOCITY_NOISE;
+}
+
+void MotionEstimator::Axis::update(double z, double dt)
+{
+	// Predict over dt, with the velocity free to drift by the acceleration
+	// noise
+	if ( dt > 0 ) {
+		double q = KALMAN_ACCELERATION_NOISE * KALMAN_ACCELERATION_NOISE;
+		p += v * dt;
+		pp += dt * (2 * pv + dt * vv) + q * dt * dt * dt * dt / 4;
+		pv += dt * vv + q * dt * dt * dt / 2;
+		vv += q * dt * dt;
+	}
+
+	// Correct towards the measurement
+	double s = pp + KALMAN_POSITION_NOISE * KALMAN_POSITION_NOISE;
+	double kp = pp / s;
+	double kv = pv / s;
+	double innovation = z - p;
+	p += kp * innovation;
+	v += kv * innovation;
+	vv -= kv * pv;
+	pv -= kp * pv;
+	pp -= kp * pp;
+}
+
+void MotionEstimator::add(MotionModel model, double t, const Point2d &centre)
+{
+	if ( model != this->model ) {
+		this->model = model;
+		samples.clear();
+		velocity = Point2d();
+	}
+
+	Sample sample{t, centre};
+	switch(model) {
+	case MOTION_AVERAGE:
+		samples.push_front(sample);
+		velocity = Point2d();
+		for(size_t i=1; i < samples.size(); i++) {
+			const Sample &newer = samples[i - 1];
+			const Sample &older = samples[i];
+			double dt = newer.t - older.t;
+			velocity.x += (newer.centre.x - older.centre.x)/dt * (1.0/VELOCITY_SAMPLES);
+			velocity.y += (newer.centre.y - older.centre.y)/dt * (1.0/VELOCITY_SAMPLES);
+		}
+		break;
+	case MOTION_LEAST_SQUARES:
+		if ( samples.size() == VELOCITY_SAMPLES + 1 )
+			addToSums(samples[VELOCITY_SAMPLES], -1);
+		samples.push_front(sample);
+		if ( samples.size() == 1 || ++sinceRebuild > VELOCITY_SAMPLES )
+			rebuildSums();
+		else
+			addToSums(sample, 1);
+		fitLine();
+		break;
+	case MOTION_KALMAN:
+		if ( samples.empty() ) {
+			kx.start(centre.x);
+			ky.start(centre.y);
+		} else {
+			double dt = t - samples.front().t;
+			kx.update(centre.x, dt);
+			ky.update(centre.y, dt);
+		}
+		samples.push_front(sample);
+		velocity = Point2d(kx.v, ky.v);
+		break;
+	}
+}
+
+void MotionEstimator::addToSums(const Sample &s, double sign)
+{
+	double dt = s.t - origin;
+	st += sign * dt;
+	stt += sign * dt * dt;
+	sc += sign * s.centre;
+	stc += sign * dt * s.centre;
+}
+
+void MotionEstimator::rebuildSums()
+{
+	origin = samples.front().t;
+	st = 0;
+	stt = 0;
+	sc = Point2d();
+	stc = Point2d();
+	for(size_t i=0; i < samples.size(); i++)
+		addToSums(samples[i], 1);
+	sinceRebuild = 0;
+}
+
+void MotionEstimator::fitLine()
+{
+	double n = static_cast<double>(samples.size());
+	double spread = n * stt - st * st;
+	if ( samples.size() < 2 || spread <= 1e-12 * n * stt ) {
+		velocity = Point2d();  // no time between the samples to measure over
+		return;
+	}
+	velocity = (n * stc - st * sc) * (1.0 / spread);
+}
+
+Point2d MotionEstimator::displacement(double t) const
+{
+	if ( samples.empty() )
+		return Point2d();
+
+	const Sample &newest = samples.front();
+	switch(model) {
+	case MOTION_LEAST_SQUARES: {
+		Point2d intercept = (sc - st * velocity) * (1.0 / samples.size());
+		return intercept + (t - origin) * velocity - newest.centre;
+	}
+	case MOTION_KALMAN:
+		return Point2d(kx.p + kx.v * (t - newest.t), ky.p + ky.v * (t - newest.t)) - newest.centre;
+	default:
+		return (t - newest.t) * velocity;
+	}
+}
+
+const char *MotionEstimator::name(MotionModel model)
+{
+	return MODEL_NAMES[model];
+}
+
+bool MotionEstimator::parse(const string &name, MotionModel &model)
+{
+	for(int i=MOTION_AVERAGE; i <= MOTION_KALMAN; i++) {
+		if ( name == MODEL_NAMES[i] ) {
+			model = static_cast<MotionModel>(i);
+			return true;
+		}
+	}
+	return false;
+}
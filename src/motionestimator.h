@@ -0,0 +1,112 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef MOTIONESTIMATOR_H
+#define MOTIONESTIMATOR_H
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+#include "videoprocessordetectionsettings.h"
+#include "ringbuffer.h"
+
+namespace cvqm {
+	class MotionEstimator;
+}
+
+/*
+ * Estimates an entity's velocity from the centres of its boxes, with the
+ * model chosen by motion_model:
+ *
+ * - average: the mean of the velocities between the newest boxes, as a
+ *   sum over at most VELOCITY_SAMPLES steps divided by VELOCITY_SAMPLES,
+ *   so young entities start slow.
+ * - least squares: the slope of a straight line fitted through the newest
+ *   samples, from running sums that each update adds the newest sample
+ *   to and takes the oldest from.  The sums are rebuilt about a fresh time
+ *   origin once per window, so rounding errors do not build up.
+ * - kalman: a constant velocity Kalman filter for each axis, which also
+ *   smooths the position the entity is predicted from.
+ *
+ * Every model updates in constant time, in place, so entities can be
+ * pooled.  Changing the model restarts the estimate.
+ */
+class cvqm::MotionEstimator
+{
+public:
+	static constexpr size_t VELOCITY_SAMPLES = 10;
+
+private:
+	// Assumed spread of a measured centre, pixels, and of the change in
+	// velocity per second, pixels per second squared
+	static constexpr double KALMAN_POSITION_NOISE = 2.0;
+	static constexpr double KALMAN_ACCELERATION_NOISE = 100.0;
+	static constexpr double KALMAN_INITIAL_VELOCITY_NOISE = 500.0;
+
+	struct Sample {
+		double t;
+		cv::Point2d centre;
+	};
+
+	// Position and velocity along one axis, with their covariance
+	struct Axis {
+		double p;
+		double v;
+		double pp;
+		double pv;
+		double vv;
+
+		void start(double z);
+		void update(double z, double dt);
+	};
+
+	MotionModel model = MOTION_AVERAGE;
+	RingBuffer<Sample, VELOCITY_SAMPLES + 1> samples;
+	cv::Point2d velocity;
+
+	// Least squares sums, with times measured from origin
+	double origin = 0;
+	size_t sinceRebuild = 0;
+	double st = 0;
+	double stt = 0;
+	cv::Point2d sc;
+	cv::Point2d stc;
+
+	Axis kx;
+	Axis ky;
+
+	void addToSums(const Sample &s, double sign);
+	void rebuildSums();
+	void fitLine();
+
+public:
+	void add(MotionModel model, double t, const cv::Point2d &centre);
+
+	// Pixels per second
+	cv::Point2d getVelocity() const { return velocity; }
+
+	// How far the entity is expected to have moved at time t from the
+	// newest centre added
+	cv::Point2d displacement(double t) const;
+
+	static const char *name(MotionModel model);
+	static bool parse(const std::string &name, MotionModel &model);
+};
+
+#endif // MOTIONESTIMATOR_H
@@ -0,0 +1,101 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "motionthresholder.h"
+
+using namespace std;
+using namespace cvqm;
+
+namespace {
+	// Colour rows are thresholded in chunks of this many pixels, so that the
+	// per-channel detection bytes stay in a small stack buffer
+	constexpr int COLOUR_CHUNK = 128;
+
+	uchar clampThreshold(int threshold)
+	{
+		return static_cast<uchar>(min(255, max(0, threshold)));
+	}
+}
+
+MotionThresholder::MotionThresholder(int detectionThreshold, int blendingThreshold, int channels) :
+	detectionThreshold(clampThreshold(detectionThreshold)),
+	blendingThreshold(clampThreshold(blendingThreshold)),
+	channels(channels)
+{
+}
+
+void MotionThresholder::thresholdRow(const uchar *frame, const uchar *background, uchar *delta, uchar *detection,
+									 uchar *blending, int cols) const
+{
+	if ( channels == 1 ) {
+		thresholdBytes(frame, background, delta, detection, blending, cols, detectionThreshold, blendingThreshold);
+		return;
+	}
+
+	uchar channelDetection[COLOUR_CHUNK * 4];
+	for(int x=0; x < cols; x += COLOUR_CHUNK) {
+		int pixels = min(COLOUR_CHUNK, cols - x);
+		int offset = x * channels;
+		thresholdBytes(frame + offset, background + offset, delta ? delta + offset : nullptr, channelDetection,
+					   blending + offset, pixels * channels, detectionThreshold, blendingThreshold);
+		for(int i=0; i < pixels; i++) {
+			uchar any = 0;
+			for(int c=0; c < channels; c++)
+				any |= channelDetection[i * channels + c];
+			detection[x + i] = any;
+		}
+	}
+}
+
+void MotionThresholder::thresholdBytes(const uchar *frame, const uchar *background, uchar *delta, uchar *detection,
+									   uchar *blending, int n, uchar detectionThreshold, uchar blendingThreshold)
+{
+	int x = 0;
+#ifdef __SSE2__
+	// |a - b| is the OR of the two saturating differences, and d > t exactly
+	// when the saturating difference d - t is non-zero
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i detectionLevel = _mm_set1_epi8(static_cast<char>(detectionThreshold));
+	const __m128i blendingLevel = _mm_set1_epi8(static_cast<char>(blendingThreshold));
+	for(; x + 16 <= n; x += 16) {
+		__m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + x));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + x));
+		__m128i d = _mm_or_si128(_mm_subs_epu8(f, b), _mm_subs_epu8(b, f));
+		if ( delta )
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(delta + x), d);
+		__m128i belowDetection = _mm_cmpeq_epi8(_mm_subs_epu8(d, detectionLevel), zero);
+		__m128i belowBlending = _mm_cmpeq_epi8(_mm_subs_epu8(d, blendingLevel), zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(detection + x), _mm_xor_si128(belowDetection, _mm_set1_epi8(-1)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(blending + x), _mm_xor_si128(belowBlending, _mm_set1_epi8(-1)));
+	}
+#endif
+	for(; x < n; x++) {
+		uchar d = static_cast<uchar>(frame[x] > background[x] ? frame[x] - background[x] : background[x] - frame[x]);
+		if ( delta )
+			delta[x] = d;
+		detection[x] = d > detectionThreshold ? 255 : 0;
+		blending[x] = d > blendingThreshold ? 255 : 0;
+	}
+}
@@ -0,0 +1,57 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef MOTIONTHRESHOLDER_H
+#define MOTIONTHRESHOLDER_H
+
+#include <opencv2/opencv.hpp>
+
+namespace cvqm {
+	class MotionThresholder;
+}
+
+/*
+ * Computes the difference between the blurred frame and background, and
+ * both of its thresholds, in a single pass over each row.  The blending mask
+ * has a byte per channel, as the background is blended per channel; the
+ * detection mask has a byte per pixel which is set when any channel exceeds
+ * the detection threshold.  Masks are 255 where the difference is greater
+ * than the threshold, as with THRESH_BINARY.
+ */
+class cvqm::MotionThresholder
+{
+private:
+	uchar detectionThreshold;
+	uchar blendingThreshold;
+	int channels;
+
+	static void thresholdBytes(const uchar *frame, const uchar *background, uchar *delta, uchar *detection,
+							   uchar *blending, int n, uchar detectionThreshold, uchar blendingThreshold);
+
+public:
+	// Thresholds are clamped to 0..255
+	MotionThresholder(int detectionThreshold, int blendingThreshold, int channels);
+
+	// Processes one row of cols pixels.  delta receives the absolute
+	// difference, and may be null when it is not wanted.
+	void thresholdRow(const uchar *frame, const uchar *background, uchar *delta, uchar *detection,
+					  uchar *blending, int cols) const;
+};
+
+#endif // MOTIONTHRESHOLDER_H
@@ -0,0 +1,170 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <chrono>
+#include <functional>
+
+#include "multicameraengine.h"
+
+using namespace std;
+using namespace cvqm;
+
+MultiCameraEngine::MultiCameraEngine(unsigned threadCount) :
+	pool(threadCount)
+{
+}
+
+void MultiCameraEngine::addCamera(const string &name, VideoProcessor *processor)
+{
+	unique_ptr<Camera> c(new Camera());
+	c->name = name;
+	c->processor = processor;
+	for(size_t i=0; i<PACKET_COUNT; i++)
+		c->recycled.push(unique_ptr<FramePacket>(new FramePacket()));
+	cameras.push_back(move(c));
+}
+
+void MultiCameraEngine::run(ostream &reportStream, double reportInterval)
+{
+	for(unique_ptr<Camera> &c: cameras) {
+		try {
+			if ( !c->processor->open() ) {
+				c->finished.store(true);
+				continue;
+			}
+		} catch (...) {
+			c->captureFailure = current_exception();
+			c->finished.store(true);
+			continue;
+		}
+		{
+			lock_guard<mutex> lock(m);
+			running++;
+		}
+		c->captureThread = thread(&MultiCameraEngine::capture, this, ref(*c));
+	}
+
+	unique_lock<mutex> lock(m);
+	while ( running > 0 ) {
+		if ( cameraFinished.wait_for(lock, chrono::duration<double>(reportInterval), [this]{ return running == 0; }) )
+			break;
+		lock.unlock();
+		for(unique_ptr<Camera> &c: cameras) {
+			if ( c->finished.load() )
+				continue;
+			VideoProcessorStatistics st = c->processor->getStatistics();
+			reportStream << c->name << ": " << st.fps << " fps, " << st.latency << " ms latency (max "
+						 << st.maxLatency << " ms), " << st.frames << " frames, "
+						 << st.bufferAllocations << " buffer allocations, "
+						 << 100 * st.skippedPixels << "% of pixels skipped, correlation " << st.correlationTime << " ms, "
+						 << 100 * st.updatedEntities << "% of entities updated" << endl;
+		}
+		lock.lock();
+	}
+	lock.unlock();
+
+	for(unique_ptr<Camera> &c: cameras) {
+		if ( c->captureThread.joinable() )
+			c->captureThread.join();
+		c->processor->close();
+		report(reportStream, c->captureFailure, c->name);
+		report(reportStream, c->processFailure, c->name);
+	}
+}
+
+void MultiCameraEngine::requestShutdown()
+{
+	for(unique_ptr<Camera> &c: cameras)
+		c->processor->requestShutdown();
+}
+
+void MultiCameraEngine::capture(Camera &c)
+{
+	try {
+		unique_ptr<FramePacket> packet;
+		while ( !c.processor->isShutdownRequested() && c.recycled.pop(packet) ) {
+			if ( !c.processor->captureFrame(*packet) || !c.captured.push(move(packet)) )
+				break;
+			schedule(c);
+		}
+	} catch (...) {
+		c.captureFailure = current_exception();
+	}
+	c.captured.close();
+	schedule(c);
+}
+
+void MultiCameraEngine::schedule(Camera &c)
+{
+	if ( !c.scheduled.exchange(true) )
+		pool.submit([this, &c]() { process(c); });
+}
+
+void MultiCameraEngine::process(Camera &c)
+{
+	for(;;) {
+		unique_ptr<FramePacket> packet;
+		while ( c.captured.tryPop(packet) ) {
+			// After a failure, whatever was captured before the shutdown took
+			// hold is discarded
+			if ( !c.processFailure ) {
+				try {
+					c.processor->processPixels(*packet);
+					c.processor->trackFrame(*packet);
+				} catch (...) {
+					c.processFailure = current_exception();
+					c.processor->requestShutdown();
+				}
+			}
+			c.recycled.push(move(packet));
+		}
+
+		if ( c.captured.drained() ) {
+			finish(c);
+			return;
+		}
+
+		// A frame may have been queued after the last pop; keep going if so,
+		// unless the capture thread has already scheduled a new task for it.
+		c.scheduled.store(false);
+		if ( (c.captured.empty() && !c.captured.drained()) || c.scheduled.exchange(true) )
+			return;
+	}
+}
+
+void MultiCameraEngine::finish(Camera &c)
+{
+	c.finished.store(true);
+	lock_guard<mutex> lock(m);
+	running--;
+	cameraFinished.notify_all();
+}
+
+void MultiCameraEngine::report(ostream &out, const exception_ptr &failure, const string &name)
+{
+	if ( !failure )
+		return;
+	try {
+		rethrow_exception(failure);
+	} catch (const exception &e) {
+		out << name << ": " << e.what() << endl;
+	} catch (...) {
+		out << name << ": stopped on unknown exception" << endl;
+	}
+}
@@ -0,0 +1,89 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef MULTICAMERAENGINE_H
+#define MULTICAMERAENGINE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <ostream>
+
+#include "videoprocessor.h"
+#include "boundedqueue.h"
+#include "workerpool.h"
+
+namespace cvqm {
+	class MultiCameraEngine;
+}
+
+/*
+ * Hosts several independent VideoProcessor pipelines in one process.  Each
+ * camera has a capture thread that only blocks on its device; the pixel and
+ * tracking work of every camera is scheduled onto one shared WorkerPool,
+ * with at most one frame per camera in progress at a time.
+ */
+class cvqm::MultiCameraEngine
+{
+private:
+	static constexpr size_t CAPTURE_DEPTH = 2;
+	static constexpr size_t PACKET_COUNT = CAPTURE_DEPTH + 2;
+
+	struct Camera {
+		std::string name;
+		VideoProcessor *processor;
+		BoundedQueue<std::unique_ptr<FramePacket>> captured{CAPTURE_DEPTH};
+		BoundedQueue<std::unique_ptr<FramePacket>> recycled{PACKET_COUNT};
+		std::atomic<bool> scheduled{false};
+		std::atomic<bool> finished{false};
+		std::thread captureThread;
+		std::exception_ptr captureFailure;
+		std::exception_ptr processFailure;
+	};
+
+	WorkerPool pool;
+	std::vector<std::unique_ptr<Camera>> cameras;
+	std::mutex m;
+	std::condition_variable cameraFinished;
+	size_t running = 0;
+
+	void capture(Camera &c);
+	void schedule(Camera &c);
+	void process(Camera &c);
+	void finish(Camera &c);
+	static void report(std::ostream &out, const std::exception_ptr &failure, const std::string &name);
+
+public:
+	explicit MultiCameraEngine(unsigned threadCount = 0);
+
+	// The processor is not owned and must outlive run()
+	void addCamera(const std::string &name, VideoProcessor *processor);
+
+	// Runs until every camera has stopped, writing per-camera statistics
+	// to the report stream every reportInterval seconds
+	void run(std::ostream &reportStream, double reportInterval);
+	void requestShutdown();
+};
+
+#endif // MULTICAMERAENGINE_H
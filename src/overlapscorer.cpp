@@ -0,0 +1,180 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <cmath>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "overlapscorer.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+void OverlapScorer::clear()
+{
+	x.clear();
+	y.clear();
+	width.clear();
+	height.clear();
+}
+
+void OverlapScorer::add(const Rect &box)
+{
+	x.push_back(box.x);
+	y.push_back(box.y);
+	width.push_back(box.width);
+	height.push_back(box.height);
+}
+
+void OverlapScorer::score(const Rect &r, const vector<int> &items, vector<OverlapType> &types, vector<double> &ratios) const
+{
+	size_t n = items.size();
+	types.resize(n);
+	ratios.resize(n);
+
+	size_t i = 0;
+#ifdef __SSE2__
+	// Every lane works through each case in the order overlaps() does, so
+	// that the ratios round identically
+	const __m128d rx = _mm_set1_pd(r.x);
+	const __m128d ry = _mm_set1_pd(r.y);
+	const __m128d rx2 = _mm_set1_pd(r.x + r.width);
+	const __m128d ry2 = _mm_set1_pd(r.y + r.height);
+	const __m128d ra = _mm_set1_pd(r.area());
+	const __m128d rcx = _mm_set1_pd((-r.width/2.0) + r.x);
+	const __m128d rcy = _mm_set1_pd((-r.height/2.0) + r.y);
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d half = _mm_set1_pd(0.5);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d signBit = _mm_set1_pd(-0.0);
+
+	auto within = [](__m128d px, __m128d py, __m128d x0, __m128d y0, __m128d x1, __m128d y1) {
+		return _mm_and_pd(_mm_and_pd(_mm_cmpge_pd(px, x0), _mm_cmple_pd(px, x1)),
+						  _mm_and_pd(_mm_cmpge_pd(py, y0), _mm_cmple_pd(py, y1)));
+	};
+	auto select = [](__m128d mask, __m128d a, __m128d b) {
+		return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+	};
+
+	for(; i + 2 <= n; i += 2) {
+		int a = items[i];
+		int b = items[i + 1];
+		__m128d ex = _mm_set_pd(x[b], x[a]);
+		__m128d ey = _mm_set_pd(y[b], y[a]);
+		__m128d ew = _mm_set_pd(width[b], width[a]);
+		__m128d eh = _mm_set_pd(height[b], height[a]);
+		__m128d ex2 = _mm_add_pd(ex, ew);
+		__m128d ey2 = _mm_add_pd(ey, eh);
+
+		__m128d etl = within(rx, ry, ex, ey, ex2, ey2);
+		__m128d ebr = within(rx2, ry2, ex, ey, ex2, ey2);
+		__m128d rtl = within(ex, ey, rx, ry, rx2, ry2);
+		__m128d rbr = within(ex2, ey2, rx, ry, rx2, ry2);
+		__m128d ea = _mm_mul_pd(ew, eh);
+
+		// Apart: by size and distance between the corners opposite the tl
+		__m128d ecx = _mm_add_pd(_mm_div_pd(_mm_sub_pd(zero, ew), two), ex);
+		__m128d ecy = _mm_add_pd(_mm_div_pd(_mm_sub_pd(zero, eh), two), ey);
+		__m128d dx = _mm_sub_pd(rcx, ecx);
+		__m128d dy = _mm_sub_pd(rcy, ecy);
+		__m128d dist = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+		__m128d areaCorrelation = _mm_sub_pd(one, _mm_div_pd(_mm_andnot_pd(signBit, _mm_sub_pd(ea, ra)), _mm_add_pd(ea, ra)));
+		__m128d distCorrelation = _mm_div_pd(_mm_sqrt_pd(_mm_min_pd(ea, ra)), dist);
+		__m128d apart = _mm_add_pd(_mm_mul_pd(areaCorrelation, half), _mm_mul_pd(distCorrelation, half));
+
+		// Overlapping: intersection over union
+		__m128d iw = _mm_sub_pd(_mm_min_pd(rx2, ex2), _mm_max_pd(rx, ex));
+		__m128d ih = _mm_sub_pd(_mm_min_pd(ry2, ey2), _mm_max_pd(ry, ey));
+		__m128d meets = _mm_and_pd(_mm_cmpgt_pd(iw, zero), _mm_cmpgt_pd(ih, zero));
+		__m128d oa = _mm_and_pd(meets, _mm_mul_pd(iw, ih));
+		__m128d overlapping = _mm_div_pd(oa, _mm_sub_pd(_mm_add_pd(ea, ra), oa));
+
+		__m128d touching = _mm_or_pd(_mm_or_pd(etl, ebr), _mm_or_pd(rtl, rbr));
+		__m128d contained = _mm_and_pd(etl, ebr);
+		__m128d contains = _mm_andnot_pd(contained, _mm_and_pd(rtl, rbr));
+		__m128d ratio = select(contained, _mm_div_pd(ra, ea), select(contains, _mm_div_pd(ea, ra), overlapping));
+		_mm_storeu_pd(&ratios[i], select(touching, ratio, apart));
+
+		int touchingBits = _mm_movemask_pd(touching);
+		int containedBits = _mm_movemask_pd(contained);
+		int containsBits = _mm_movemask_pd(contains);
+		for(int lane=0; lane < 2; lane++) {
+			int bit = 1 << lane;
+			types[i + lane] = !(touchingBits & bit) ? OVERLAP_TYPE_NONE :
+							  (containedBits & bit) ? OVERLAP_TYPE_CONTAINED :
+							  (containsBits & bit) ? OVERLAP_TYPE_CONTAINS : OVERLAP_TYPE_OVERLAPS;
+		}
+	}
+#endif
+	for(; i < n; i++) {
+		int e = items[i];
+		Rect box(static_cast<int>(x[e]), static_cast<int>(y[e]), static_cast<int>(width[e]), static_cast<int>(height[e]));
+		types[i] = overlaps(r, box, ratios[i]);
+	}
+}
+
+bool OverlapScorer::contains(const Rect &r, Point2i p)
+{
+	int xl = r.x;
+	int xh = r.x + r.width;
+	int yl = r.y;
+	int yh = r.y + r.height;
+
+	return p.x >= xl && p.x <= xh && p.y >= yl && p.y <= yh;
+}
+
+OverlapType OverlapScorer::overlaps(const Rect &r, const Rect &e, double &overlapRatio)
+{
+	bool etl = contains(e, r.tl());
+	bool ebr = contains(e, r.br());
+	bool rtl = contains(r, e.tl());
+	bool rbr = contains(r, e.br());
+
+	double ea = e.area();
+	double ra = r.area();
+
+	if ( !etl && !ebr && !rtl && !rbr ) {
+		Point2d rc = Point2d((-r.width/2.0) + r.x, (-r.height/2.0) + r.y);
+		Point2d ec = Point2d((-e.width/2.0) + e.x, (-e.height/2.0) + e.y);
+		double dist = sqrt( (rc.x - ec.x)*(rc.x - ec.x) + (rc.y - ec.y)*(rc.y - ec.y));
+
+		double areaCorrelation = 1 - (abs(ea-ra)/(ea+ra));
+		double distCorrelation = sqrt(min(ea, ra)) / dist;
+		overlapRatio = areaCorrelation * 0.50 + distCorrelation * 0.50;
+		return OVERLAP_TYPE_NONE;
+	}
+
+	if ( etl && ebr ) {
+		overlapRatio = ra/ea;
+		return OVERLAP_TYPE_CONTAINED;
+	}
+
+	if ( rtl && rbr ) {
+		overlapRatio = ea/ra;
+		return OVERLAP_TYPE_CONTAINS;
+	}
+
+	double oa = (r&e).area();
+	overlapRatio = oa / (ea + ra - oa);
+	return OVERLAP_TYPE_OVERLAPS;
+}
@@ -0,0 +1,70 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef OVERLAPSCORER_H
+#define OVERLAPSCORER_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace cvqm {
+	class OverlapScorer;
+
+	// How a rect lies against another, as VideoProcessor::overlaps() finds
+	enum OverlapType {
+		OVERLAP_TYPE_NONE = 0,
+		OVERLAP_TYPE_CONTAINS = 1,
+		OVERLAP_TYPE_CONTAINED = 2,
+		OVERLAP_TYPE_OVERLAPS = 4
+	};
+}
+
+/*
+ * Scores one rect against many boxes at once, with the same types and
+ * ratios, to the bit, as VideoProcessor::overlaps() gives pair by pair.
+ * Boxes are held as a structure of arrays of doubles, and every case is
+ * computed for two boxes at a time in SSE2 lanes, with the result picked
+ * by masks rather than branches.  Boxes are kept from one clear() to the
+ * next so that their storage is only allocated once.
+ */
+class cvqm::OverlapScorer
+{
+private:
+	std::vector<double> x;
+	std::vector<double> y;
+	std::vector<double> width;
+	std::vector<double> height;
+
+public:
+	void clear();
+	void add(const cv::Rect &box);
+
+	// Scores r against the boxes numbered in items, filling types and
+	// ratios in the same order
+	void score(const cv::Rect &r, const std::vector<int> &items,
+			   std::vector<OverlapType> &types, std::vector<double> &ratios) const;
+
+	// Whether p lies within r, edges included
+	static bool contains(const cv::Rect &r, cv::Point2i p);
+
+	// A single pair, as scored in the lanes
+	static OverlapType overlaps(const cv::Rect &r, const cv::Rect &e, double &overlapRatio);
+};
+
+#endif // OVERLAPSCORER_H
@@ -0,0 +1,170 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "rectassigner.h"
+
+using namespace std;
+using namespace cvqm;
+
+namespace {
+	const char *const ENGINE_NAMES[] = { "greedy", "optimal" };
+	const double UNREACHED = numeric_limits<double>::infinity();
+
+	// Weights past this are capped, so that an infinite score still sums
+	constexpr double MAX_WEIGHT = 1e6;
+}
+
+void RectAssigner::reset(int rows, int columns)
+{
+	this->rows = rows;
+	this->columns = columns;
+	edges.clear();
+}
+
+void RectAssigner::add(int row, int column, double weight)
+{
+	edges.push_back(Edge{row, column, -min(weight, MAX_WEIGHT)});
+}
+
+void RectAssigner::solve()
+{
+	// Edges listed by row
+	rowStart.assign(rows + 1, 0);
+	for(const Edge &e: edges)
+		rowStart[e.row + 1]++;
+	for(int r=0; r < rows; r++)
+		rowStart[r + 1] += rowStart[r];
+	byRow.resize(edges.size());
+	touched.assign(rowStart.begin(), rowStart.end() - 1);
+	for(int i=0; i < static_cast<int>(edges.size()); i++)
+		byRow[touched[edges[i].row]++] = i;
+	touched.clear();
+
+	int allColumns = columns + rows;
+	price.assign(allColumns, 0);
+	columnRow.assign(allColumns, -1);
+	rowColumn.assign(rows, -1);
+	rowEdge.assign(rows, -1);
+	distance.assign(allColumns, UNREACHED);
+	previousRow.resize(allColumns);
+	previousEdge.resize(allColumns);
+	settled.assign(allColumns, 0);
+
+	for(int r=0; r < rows; r++) {
+		if ( rowStart[r] == rowStart[r + 1] ) {
+			// Nothing to pair with but its own column
+			rowColumn[r] = columns + r;
+			columnRow[columns + r] = r;
+		} else {
+			augment(r);
+		}
+	}
+}
+
+void RectAssigner::augment(int row)
+{
+	auto reach = [this](int r, double d, double u) {
+		auto relax = [&](int edge, int column) {
+			double reduced = max(0.0, cost(edge) - u - price[column]);
+			if ( d + reduced < distance[column] ) {
+				if ( distance[column] == UNREACHED )
+					touched.push_back(column);
+				distance[column] = d + reduced;
+				previousRow[column] = r;
+				previousEdge[column] = edge;
+				heap.emplace_back(d + reduced, column);
+				push_heap(heap.begin(), heap.end(), greater<pair<double, int>>());
+			}
+		};
+		for(int i=rowStart[r]; i < rowStart[r + 1]; i++)
+			relax(byRow[i], edges[byRow[i]].column);
+		relax(-1, columns + r);
+	};
+
+	// The new row's dual makes its cheapest edge tight
+	double u = -price[columns + row];
+	for(int i=rowStart[row]; i < rowStart[row + 1]; i++)
+		u = min(u, edges[byRow[i]].cost - price[edges[byRow[i]].column]);
+	heap.clear();
+	reach(row, 0, u);
+
+	int freeColumn = -1;
+	double shortest = 0;
+	while ( freeColumn < 0 ) {
+		pop_heap(heap.begin(), heap.end(), greater<pair<double, int>>());
+		double d = heap.back().first;
+		int column = heap.back().second;
+		heap.pop_back();
+		if ( settled[column] || d > distance[column] )
+			continue;
+		settled[column] = 1;
+		ready.push_back(column);
+		int r = columnRow[column];
+		if ( r < 0 ) {
+			freeColumn = column;
+			shortest = d;
+		} else {
+			// Paired rows sit on a tight edge, which gives their dual
+			reach(r, d, cost(rowEdge[r]) - price[column]);
+		}
+	}
+
+	// Columns settled on the way lower their prices by how much shorter
+	// their paths were, which keeps every reduced cost non-negative
+	for(int column: ready)
+		price[column] += distance[column] - shortest;
+
+	for(int column = freeColumn;;) {
+		int r = previousRow[column];
+		int next = rowColumn[r];
+		columnRow[column] = r;
+		rowColumn[r] = column;
+		rowEdge[r] = previousEdge[column];
+		if ( r == row )
+			break;
+		column = next;
+	}
+
+	for(int column: touched) {
+		distance[column] = UNREACHED;
+		settled[column] = 0;
+	}
+	touched.clear();
+	ready.clear();
+}
+
+const char *RectAssigner::name(AssignEngine engine)
+{
+	return ENGINE_NAMES[engine];
+}
+
+bool RectAssigner::parse(const string &name, AssignEngine &engine)
+{
+	for(int i=ASSIGN_GREEDY; i <= ASSIGN_OPTIMAL; i++) {
+		if ( name == ENGINE_NAMES[i] ) {
+			engine = static_cast<AssignEngine>(i);
+			return true;
+		}
+	}
+	return false;
+}
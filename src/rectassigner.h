@@ -0,0 +1,88 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef RECTASSIGNER_H
+#define RECTASSIGNER_H
+
+#include <string>
+#include <vector>
+
+#include "videoprocessordetectionsettings.h"
+
+namespace cvqm {
+	class RectAssigner;
+}
+
+/*
+ * Pairs rows (entities) with columns (rects) one to one, over a sparse set
+ * of weighted edges, so that the total weight of the pairs is the greatest
+ * possible.  A row need not be paired: each has a private column of its
+ * own at weight 0, so only edges that add to the total are taken.
+ *
+ * Rows are added one at a time by the Jonker-Volgenant shortest augmenting
+ * path, found with Dijkstra over the edges alone, and column prices are
+ * kept between rows so that reduced costs stay non-negative.  The work
+ * grows with the edges rather than with rows times columns, which keeps
+ * gated problems of a few hundred rows well under a millisecond.  Working
+ * buffers are kept between calls.
+ */
+class cvqm::RectAssigner
+{
+private:
+	struct Edge {
+		int row;
+		int column;
+		double cost;  // the negated weight
+	};
+
+	int rows = 0;
+	int columns = 0;
+	std::vector<Edge> edges;
+	std::vector<int> rowStart;   // each row's edges, indexing byRow
+	std::vector<int> byRow;
+
+	std::vector<double> price;   // per column, the real ones then each row's own
+	std::vector<int> columnRow;
+	std::vector<int> rowColumn;
+	std::vector<int> rowEdge;    // the edge a row is paired by, -1 for its own column
+	std::vector<double> distance;
+	std::vector<int> previousRow;
+	std::vector<int> previousEdge;
+	std::vector<char> settled;
+	std::vector<int> touched;
+	std::vector<int> ready;
+	std::vector<std::pair<double, int>> heap;
+
+	double cost(int edge) const { return edge < 0 ? 0 : edges[edge].cost; }
+	void augment(int row);
+
+public:
+	void reset(int rows, int columns);
+	void add(int row, int column, double weight);
+	void solve();
+
+	// The edge, as numbered by the order of add() calls, pairing the row,
+	// or -1 if it was left unpaired
+	int assigned(int row) const { return rowEdge[row]; }
+
+	static const char *name(AssignEngine engine);
+	static bool parse(const std::string &name, AssignEngine &engine);
+};
+
+#endif // RECTASSIGNER_H
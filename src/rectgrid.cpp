@@ -0,0 +1,59 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+
+#include "rectgrid.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+void RectGrid::reset(Size frame, int cellSize)
+{
+	this->cellSize = max(1, cellSize);
+	columns = max(1, (frame.width + this->cellSize - 1) / this->cellSize);
+	rows = max(1, (frame.height + this->cellSize - 1) / this->cellSize);
+	cells.resize(static_cast<size_t>(columns) * rows);
+	for(vector<int> &cell: cells)
+		cell.clear();
+}
+
+Rect RectGrid::cellRange(const Rect &r) const
+{
+	// Cells from the one holding the top left pixel to the one holding the
+	// bottom right pixel, clamped to the grid
+	auto cell = [this](int v, int count) {
+		int c = v >= 0 ? v / cellSize : -1;
+		return min(count - 1, max(0, c));
+	};
+	int x0 = cell(r.x, columns);
+	int y0 = cell(r.y, rows);
+	int x1 = cell(r.x + max(1, r.width) - 1, columns);
+	int y1 = cell(r.y + max(1, r.height) - 1, rows);
+	return Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+void RectGrid::insert(const Rect &r, int item)
+{
+	Rect c = cellRange(r);
+	for(int y=c.y; y < c.y + c.height; y++)
+		for(int x=c.x; x < c.x + c.width; x++)
+			cells[static_cast<size_t>(y) * columns + x].push_back(item);
+}
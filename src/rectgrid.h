@@ -0,0 +1,63 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef RECTGRID_H
+#define RECTGRID_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace cvqm {
+	class RectGrid;
+}
+
+/*
+ * Uniform grid of square cells over a frame, listing the items whose rects
+ * cover each cell, so that only the items near a rect need be tested
+ * against it.  Rects past the frame are clamped to its edge cells, which
+ * keeps any two rects that intersect in a shared cell.  Cell lists keep
+ * their storage from one reset() to the next.
+ */
+class cvqm::RectGrid
+{
+private:
+	int cellSize = 1;
+	int columns = 0;
+	int rows = 0;
+	std::vector<std::vector<int>> cells;
+
+	cv::Rect cellRange(const cv::Rect &r) const;
+
+public:
+	void reset(cv::Size frame, int cellSize);
+	void insert(const cv::Rect &r, int item);
+
+	// Calls f(item) for each item in the cells r covers.  An item in several
+	// of them is passed more than once.
+	template<typename F> void query(const cv::Rect &r, F f) const
+	{
+		cv::Rect c = cellRange(r);
+		for(int y=c.y; y < c.y + c.height; y++)
+			for(int x=c.x; x < c.x + c.width; x++)
+				for(int item: cells[static_cast<size_t>(y) * columns + x])
+					f(item);
+	}
+};
+
+#endif // RECTGRID_H
@@ -0,0 +1,59 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <cstddef>
+
+namespace cvqm {
+	template<typename T, size_t Capacity> class RingBuffer;
+}
+
+/*
+ * Fixed capacity history held inline, newest first.  Once full, each
+ * push_front() overwrites the oldest item, so the storage never grows.
+ */
+template<typename T, size_t Capacity>
+class cvqm::RingBuffer
+{
+private:
+	T items[Capacity];
+	size_t newest = 0;
+	size_t count = 0;
+
+public:
+	void push_front(const T &item)
+	{
+		newest = (newest + 1) % Capacity;
+		items[newest] = item;
+		if ( count < Capacity )
+			count++;
+	}
+
+	// The i'th newest item, the newest being 0
+	const T &operator[](size_t i) const { return items[(newest + Capacity - i) % Capacity]; }
+	const T &front() const { return items[newest]; }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	void clear() { count = 0; }
+};
+
+#endif // RINGBUFFER_H
@@ -21,10 +21,19 @@
 #include <opencv2/opencv.hpp>
 #include <cmath>
 #include <sstream>
-#include <tuple>
 #include <mutex>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <chrono>
+#include <algorithm>
 
 #include "entity.h"
+#include "framesource.h"
+#include "boundedqueue.h"
+#include "bufferaudit.h"
+#include "backgroundblender.h"
+#include "motionthresholder.h"
 #include "videoprocessorconstants.h"
 #include "videoprocessor.h"
 
@@ -43,17 +52,14 @@ const Scalar VideoProcessor::CONTOUR_COLOUR = Scalar( 0,0,255 );
 DetectionObserver::~DetectionObserver() {}
 OutputImageObserver::~OutputImageObserver() {}
 
-VideoProcessor::VideoProcessor() = default;
+VideoProcessor::VideoProcessor() :
+	snapshot(make_shared<VideoProcessorSnapshot>())
+{
+}
 
 VideoProcessor::~VideoProcessor()
 {
-	for(Entity *e: this->entities)
-		delete e;
-	for(DetectionZone *z: this->detectionZones)
-		delete z;
-	for(Rect *r: this->maskZones)
-		delete r;
-	delete this->thresholdTime;
+	delete[] this->thresholdTime;
 }
 
 void VideoProcessor::setDeviceId(int id)
@@ -67,141 +73,497 @@ void VideoProcessor::setResolution(int xRes, int yRes)
 	this->yRes = yRes;
 }
 
-void VideoProcessor::run()
+void VideoProcessor::setInputFile(const string &path, double nominalFps)
 {
-	VideoCapture cap(this->device_id);
-	cap.set(CV_CAP_PROP_FRAME_WIDTH, xRes);
-	cap.set(CV_CAP_PROP_FRAME_HEIGHT, yRes);
+	this->inputFile = path;
+	this->inputFps = nominalFps;
+}
 
-	if(!cap.isOpened()) {
-		string err = "Unable to open " + to_string(this->device_id);
-		throw new invalid_argument(err);
-	}
+ulong VideoProcessor::getFrameCount() const
+{
+	return this->frameIdCounter;
+}
+
+bool VideoProcessor::open()
+{
+	if ( this->inputFile.empty() )
+		source.reset(new CameraFrameSource(this->device_id, xRes, yRes));
+	else
+		source.reset(new VideoFileFrameSource(this->inputFile, this->inputFps));
+
+	const VideoProcessorDetectionSettings &settings = currentSnapshot()->settings;
+	this->greyscale = settings.greyscale;
+	this->processingScale = max(1, settings.processing_scale);
 
-	bool greyscale;
 	{
-			lock_guard<mutex> datastructureLock(this->dsMutex);
-			greyscale = this->s.greyscale;
+		Mat frame, scaled;
+		if ( !source->read(frame, this->lastFrameTime) )
+			return false;
+		this->borderRect = Rect(1, 1, frame.cols-2, frame.rows-2);
+		convertFrame(frame, scaled, backgroundFrame);
+		backgroundBlurred = false;
+		processedRegion = Rect(Point(0, 0), backgroundFrame.size());
 	}
 
-	Mat backgroundFrame;
+	delete[] this->thresholdTime;
+	auto frameLength = static_cast<ulong>(backgroundFrame.rows * backgroundFrame.cols * backgroundFrame.channels());
+	thresholdTime = new ushort[frameLength];
+	memset(thresholdTime, 0, frameLength * sizeof(ushort));
+
 	{
-		Mat frame;
-		cap >> frame;
-		if ( greyscale )
-			cvtColor(frame, backgroundFrame, CV_BGR2GRAY);
-		else
-			backgroundFrame = frame;
+		lock_guard<mutex> statisticsLock(this->statisticsMutex);
+		this->statistics = VideoProcessorStatistics();
 	}
+	return true;
+}
 
-	Rect borderRect(1, 1, backgroundFrame.cols-2, backgroundFrame.rows-2);
+void VideoProcessor::close()
+{
+	destroyDebugWindows();
+	source.reset();
+}
 
-	if ( this->thresholdTime != nullptr )
-		delete this->thresholdTime;
-	auto frameLength = static_cast<ulong>(backgroundFrame.rows * backgroundFrame.cols * backgroundFrame.channels());
-	thresholdTime = new uint[frameLength];
-	memset(thresholdTime, 0, frameLength * sizeof(uint));
-
-	auto t0 = chrono::system_clock::now();
-	double lastFrameTime = 0;
-
-	for(;;) {
-		Mat sourceFrame;
-		cap >> sourceFrame;
-		this->frameIdCounter++;
-		showDebugWindow(sourceFrame, ORIGINAL_INPUT, showOriginal, shownOriginal);
-
-		// Calculate frame timestamps for velocity calculations
-		auto t1 = chrono::system_clock::now();
-		chrono::duration<double> frameTimeDuration = t1-t0;
-
-		double frameTime = frameTimeDuration.count();
-		double dFrameTime = frameTime - lastFrameTime;
-		lastFrameTime = frameTime;
-
-		// Convert to greyscale if greyscale mode
-		Mat frame;
-		if ( greyscale ) {
-			cvtColor(sourceFrame, frame, CV_BGR2GRAY);
-		} else {
-			frame = sourceFrame;
-		}
+void VideoProcessor::run()
+{
+	if ( !open() )
+		return;
 
-		lock_guard<mutex> datastructureLock(this->dsMutex);
-
-		// Calculate current frame difference from background
-		Mat blurBaseFrame;
-		Mat blurFrame;
-		GaussianBlur(frame, blurFrame, Size(s.blur_radius,s.blur_radius), s.blur_stdev, 0, BORDER_REFLECT_101);
-		GaussianBlur(backgroundFrame, blurBaseFrame, Size(s.blur_radius,s.blur_radius), s.blur_stdev, 0, BORDER_REFLECT_101);
-		Mat delta;
-		absdiff(blurFrame, blurBaseFrame, delta);
-		showDebugWindow(blurFrame, BLURRED_INPUT, showBlur, shownBlur);
-		showDebugWindow(delta, BACKGROUND_DIFFERENCE, showDelta, shownDelta);
-
-		// Threshold frame difference to detect motion
-		Mat detectionThresholdRgb;
-		threshold(delta, detectionThresholdRgb, s.detection_threshold, 255, THRESH_BINARY);
-		showDebugWindow(detectionThresholdRgb, THRESHOLDED_DELTA, showThreshold, shownThreshold);
-		Mat detectionThreshold;
-		if ( !greyscale )
-			cvtColor(detectionThresholdRgb, detectionThreshold, COLOR_BGR2GRAY);
-		else
-			detectionThreshold = detectionThresholdRgb;
-
-		// Dilate the thresholded frame
-		Mat dilateDetectionKernel = getStructuringElement(
-					MORPH_ELLIPSE,
-					Size(2*s.dilateDetectionFactor, 2*s.dilateDetectionFactor),
-					Point(s.dilateDetectionFactor,s.dilateDetectionFactor)
-					);
-		Mat dilatedDetection;
-		for(Rect *maskZone: maskZones)
-			rectangle(detectionThreshold, *maskZone, Scalar(0), -1);
-		dilate(detectionThreshold, dilatedDetection, dilateDetectionKernel);
-		showDebugWindow(dilatedDetection, DILATED_THRESHOLD, showDilated, shownDilated);
-
-		// Find contours and bounding boxes around thresholded objects
-		vector<vector<Point>> contours;
-		vector<Vec4i> hierarchy;
-		findContours(dilatedDetection, contours, hierarchy, RETR_EXTERNAL, CHAIN_APPROX_NONE);
-
-		Mat rectOutput;
-		sourceFrame.copyTo(rectOutput);
-		vector<Rect> rects(contours.size());
-		for(ulong i=0; i<contours.size(); i++) {
-				Rect r = boundingRect(contours[i]);
-				rects[i] = r;
+	// Capture, pixel processing and tracking run concurrently on consecutive
+	// frames.  Stopping either queue unwinds the stages upstream of it.
+	// Packets circulate back to the capture stage so their buffers are reused.
+	BoundedQueue<unique_ptr<FramePacket>> recycled(PACKET_COUNT);
+	BoundedQueue<unique_ptr<FramePacket>> captured(PIPELINE_DEPTH);
+	BoundedQueue<unique_ptr<FramePacket>> processed(PIPELINE_DEPTH);
+	exception_ptr captureFailure;
+	exception_ptr pixelFailure;
+
+	for(size_t i=0; i<PACKET_COUNT; i++)
+		recycled.push(unique_ptr<FramePacket>(new FramePacket()));
+
+	thread captureThread([&]() {
+		try {
+			unique_ptr<FramePacket> packet;
+			while ( !shutdownRequested.load() && recycled.pop(packet) ) {
+				if ( !captureFrame(*packet) || !captured.push(move(packet)) )
+					break;
+			}
+		} catch (...) {
+			captureFailure = current_exception();
+		}
+		captured.close();
+	});
+
+	thread pixelThread([&]() {
+		try {
+			unique_ptr<FramePacket> packet;
+			while ( captured.pop(packet) ) {
+				processPixels(*packet);
+				if ( !processed.push(move(packet)) )
+					break;
+			}
+		} catch (...) {
+			pixelFailure = current_exception();
 		}
+		captured.close();
+		processed.close();
+	});
+
+	try {
+		unique_ptr<FramePacket> packet;
+		while ( processed.pop(packet) ) {
+			trackFrame(*packet);
+			recycled.push(move(packet));
+		}
+	} catch (...) {
+		recycled.close();
+		processed.close();
+		captured.close();
+		pixelThread.join();
+		captureThread.join();
+		close();
+		throw;
+	}
 
-		// Correlate and process detected motion
-		correlate(rects, frame, this->frameIdCounter, frameTime);
-		detect(this->frameIdCounter, sourceFrame);
-		endEntities(this->frameIdCounter, &borderRect);
-		paintEntities(rectOutput, this->frameIdCounter, frameTime, dFrameTime);
-		performBackgroundBlending(frame, backgroundFrame, delta, thresholdTime);
+	pixelThread.join();
+	captureThread.join();
+	close();
 
+	if ( captureFailure )
+		rethrow_exception(captureFailure);
+	if ( pixelFailure )
+		rethrow_exception(pixelFailure);
+}
+
+bool VideoProcessor::captureFrame(FramePacket &packet)
+{
+	BufferAudit audit;
+	audit.watch(packet.sourceFrame);
+	audit.watch(packet.scaledFrame);
+	audit.watch(packet.frame);
 
-		if ( this->showOutput.load() || this->outputImageObserver != nullptr )
-			for(vector<vector<Point>>::size_type i = 0; i< contours.size(); i++ )
-				drawContours( rectOutput, contours, static_cast<int>(i), CONTOUR_COLOUR, 1, 8, hierarchy, 0, Point() );
-		showDebugWindow(rectOutput, LABELED_OUTPUT, showOutput, shownOutput);
-		showDebugWindow(backgroundFrame, BACKGROUND_FRAME, showBackground, shownBackground);
+	// Frame timestamps for velocity calculations come from the source
+	if ( !source->read(packet.sourceFrame, packet.frameTime) )
+		return false;
+	packet.captureTime = chrono::steady_clock::now();
+	packet.frameId = ++this->frameIdCounter;
+	packet.dFrameTime = packet.frameTime - this->lastFrameTime;
+	this->lastFrameTime = packet.frameTime;
+
+	packet.snapshot = currentSnapshot();
+
+	convertFrame(packet.sourceFrame, packet.scaledFrame, packet.frame);
+
+	packet.bufferAllocations = audit.reallocations();
+	return true;
+}
+
+void VideoProcessor::convertFrame(const Mat &source, Mat &scaled, Mat &frame)
+{
+	// Reduce to the processing resolution, then to greyscale if greyscale mode
+	const Mat *input = &source;
+	if ( processingScale > 1 ) {
+		Size size(source.cols / processingScale, source.rows / processingScale);
+		resize(source, scaled, size, 0, 0, INTER_AREA);
+		input = &scaled;
+	}
+
+	if ( greyscale )
+		cvtColor(*input, frame, CV_BGR2GRAY);
+	else
+		frame = *input;
+}
 
-		if ( this->outputImageObserver != nullptr ) {
-			this->outputImageObserver->renderedImage(&rectOutput);
+void VideoProcessor::processPixels(FramePacket &packet)
+{
+	const VideoProcessorDetectionSettings &settings = packet.snapshot->settings;
+
+	BufferAudit audit;
+	audit.watch(packet.blurFrame);
+	audit.watch(packet.delta);
+	audit.watch(blurBaseFrame);
+	audit.watch(detectionThreshold);
+	audit.watch(dilatedDetection);
+	audit.watch(blendingThreshold);
+	audit.watch(dilatedBlending);
+	size_t contourCapacity = packet.contours.capacity();
+	size_t blobCapacity = packet.blobs.capacity();
+
+	// Blur the frame and the background to compare them.  A pre-blurred
+	// background model is blended from the blurred frames instead, as blur is
+	// linear, which saves blurring the whole background again every frame.
+	smoother.configure(settings.blur_engine, settings.blur_radius, settings.blur_stdev);
+	if ( settings.blurred_background && !backgroundBlurred )
+		smoother.apply(backgroundFrame, backgroundFrame, Range(0, backgroundFrame.rows));
+	backgroundBlurred = settings.blurred_background; // a blurred model sharpens again once frames are blended in
+
+	// The outputs are allocated up front so that each stage writes its rows
+	// in place.  The difference itself is only kept for the debug windows.
+	Size size = packet.frame.size();
+	int type = packet.frame.type();
+	bool keepThreshold = showThreshold.load();
+	bool keepDelta = showDelta.load() || keepThreshold;
+	packet.blurFrame.create(size, type);
+	if ( !backgroundBlurred )
+		blurBaseFrame.create(size, type);
+	if ( keepDelta )
+		packet.delta.create(size, type);
+	else
+		packet.delta.release();
+	detectionThreshold.create(size, CV_8UC1);
+	blendingThreshold.create(size, type);
+	dilatedDetection.create(size, CV_8UC1);
+	dilatedBlending.create(size, type);
+
+	// Only the processing region is blurred, differenced, dilated, searched
+	// and blended; the images outside it are left as they were.  When the
+	// region changes the masks are cleared, as dilation reads past its
+	// edges, and the background outside the old region restarts from this
+	// frame.  Within the region, masked pixels are skipped by every stage.
+	Rect frameRect(Point(0, 0), size);
+	Mat wasMasked;
+	if ( !maskMap.current(*packet.snapshot, size, processingScale) ) {
+		if ( maskMap.image().size() == size )
+			wasMasked = maskMap.image().clone();
+		maskMap.build(*packet.snapshot, size, processingScale);
+	}
+	Rect region = processingRegion(*packet.snapshot, frameRect, maskMap.maskRects());
+	if ( region != processedRegion ) {
+		detectionThreshold.setTo(Scalar::all(0));
+		blendingThreshold.setTo(Scalar::all(0));
+		dilatedDetection.setTo(Scalar::all(0));
+		dilatedBlending.setTo(Scalar::all(0));
+		if ( backgroundBlurred )
+			smoother.apply(packet.frame, packet.blurFrame, Range(0, size.height));
+		Mat kept;
+		if ( processedRegion.area() > 0 )
+			backgroundFrame(processedRegion).copyTo(kept);
+		(backgroundBlurred ? packet.blurFrame : packet.frame).copyTo(backgroundFrame);
+		if ( !kept.empty() ) {
+			Mat keptRegion = backgroundFrame(processedRegion);
+			kept.copyTo(keptRegion);
 		}
+		memset(thresholdTime, 0, backgroundFrame.total() * backgroundFrame.channels() * sizeof(ushort));
+		processedRegion = region;
+	}
+	if ( !wasMasked.empty() ) {
+		// The background under a removed mask was not kept up to date, so it
+		// restarts from this frame
+		Mat unmasked = wasMasked & ~maskMap.image();
+		if ( countNonZero(unmasked) > 0 ) {
+			if ( backgroundBlurred )
+				smoother.apply(packet.frame, packet.blurFrame, Range(0, size.height));
+			(backgroundBlurred ? packet.blurFrame : packet.frame).copyTo(backgroundFrame, unmasked);
+		}
+	}
+	packet.skippedPixels = 1.0 - static_cast<double>(maskMap.unmaskedPixels(region)) / frameRect.area();
+
+	packet.rects.clear();
+	packet.blobs.clear();
+	if ( region.area() > 0 ) {
+		detectRegion(packet, region, keepDelta, this->showOutput.load() || this->outputImageObserver != nullptr);
+		performBackgroundBlending(backgroundBlurred ? packet.blurFrame : packet.frame, backgroundFrame, thresholdTime,
+								  region, settings);
+	} else {
+		retainDebugImage(dilatedDetection, packet.dilatedDetection, showDilated.load() || retainMasks.load());
+		packet.contours.clear();
+		packet.hierarchy.clear();
+	}
+
+	if ( keepThreshold ) // per channel
+		threshold(packet.delta, packet.thresholdedDelta, settings.detection_threshold, 255, THRESH_BINARY);
+	else
+		packet.thresholdedDelta.release();
+	retainDebugImage(dilatedBlending, packet.dilatedBlending, showDilatedBlending.load());
+	retainDebugImage(backgroundFrame, packet.background, showBackground.load());
+
+	packet.bufferAllocations += audit.reallocations();
+	if ( packet.contours.capacity() != contourCapacity )
+		packet.bufferAllocations++;
+	if ( packet.blobs.capacity() != blobCapacity )
+		packet.bufferAllocations++;
+}
 
-		if ( shutdownRequested.load() ) {
-			destroyDebugWindows();
-			return;
+void VideoProcessor::detectRegion(FramePacket &packet, const Rect &region, bool keepDelta, bool traceContours)
+{
+	const VideoProcessorDetectionSettings &settings = packet.snapshot->settings;
+
+	// Kernels are only rebuilt when the factors change
+	detectionDilator.configure(settings.dilate_engine, settings.dilateDetectionFactor);
+	blendingDilator.configure(settings.dilate_engine, settings.dilateBlendingFactor);
+
+	// Each stage works on views of the region, with rows counted from its top
+	Mat frame = packet.frame(region);
+	Mat blurFrame = packet.blurFrame(region);
+	Mat background = backgroundFrame(region);
+	Mat blurredRegion = backgroundBlurred ? background : blurBaseFrame(region);
+	Mat detection = detectionThreshold(region);
+	Mat blending = blendingThreshold(region);
+	Mat dilatedRegion = dilatedDetection(region);
+	Mat dilatedBlendingRegion = dilatedBlending(region);
+	Mat delta = keepDelta ? packet.delta(region) : Mat();
+	detectionBits.create(region.height, region.width);
+	dilatedDetectionBits.create(region.height, region.width);
+
+	// Filtering a row range uses the real rows around it, and only applies
+	// the border at the edges of the region, so each of these gives the same
+	// rows, to the bit, as filtering the whole region would.  Rows that are
+	// wholly masked are not blurred, as nothing reads them.
+	auto blurRows = [&](const Range &r) {
+		int y = r.start;
+		while ( y < r.end ) {
+			while ( y < r.end && maskMap.rowMasked(region.y + y, region.x, region.br().x) )
+				y++;
+			int start = y;
+			while ( y < r.end && !maskMap.rowMasked(region.y + y, region.x, region.br().x) )
+				y++;
+			if ( y > start ) {
+				smoother.apply(frame, blurFrame, Range(start, y));
+				if ( !backgroundBlurred )
+					smoother.apply(background, blurredRegion, Range(start, y));
+			}
 		}
+	};
+	auto dilateRows = [&](const Range &r) {
+		detectionDilator.apply(detectionBits, dilatedDetectionBits, r);
+		blendingDilator.apply(blending, dilatedBlendingRegion, r);
+	};
+
+	// Difference from the background and both thresholds in a single pass
+	// over the unmasked spans of each row.  Masked spans are only cleared.
+	// The detection row is then packed to bits, in which form it is dilated
+	// and searched for blobs.
+	MotionThresholder thresholder(settings.detection_threshold, settings.blending_threshold, frame.channels());
+	size_t channels = frame.channels();
+	auto thresholdRows = [&](const Range &r) {
+		for(int y=r.start; y < r.end; y++) {
+			uchar *detectionRow = detection.ptr(y);
+			uchar *blendingRow = blending.ptr(y);
+			uchar *deltaRow = keepDelta ? delta.ptr(y) : nullptr;
+			auto clear = [&](int start, int end) {
+				if ( start >= end )
+					return;
+				memset(detectionRow + start, 0, end - start);
+				memset(blendingRow + start * channels, 0, (end - start) * channels);
+				if ( deltaRow )
+					memset(deltaRow + start * channels, 0, (end - start) * channels);
+			};
+			int x = 0;
+			maskMap.forEachSpan(region.y + y, region.x, region.br().x, [&](int start, int end) {
+				start -= region.x;
+				end -= region.x;
+				clear(x, start);
+				size_t offset = start * channels;
+				thresholder.thresholdRow(blurFrame.ptr(y) + offset, blurredRegion.ptr(y) + offset,
+										 deltaRow ? deltaRow + offset : nullptr, detectionRow + start,
+										 blendingRow + offset, end - start);
+				x = end;
+			});
+			clear(x, region.width);
+			detectionBits.packRow(y, detectionRow);
+		}
+	};
+
+	configureStripes(settings.pixel_threads);
+	int rows = region.height;
+	if ( settings.strip_rows <= 0 || settings.strip_rows >= rows ) {
+		// Each stage over the whole region, with the thresholds in row stripes
+		blurRows(Range(0, rows));
+		forEachStripe(rows, thresholdRows);
+		dilateRows(Range(0, rows));
+	} else {
+		// Bands of strip_rows rows are pushed through the whole chain while
+		// they are still in cache.  Dilating a band reads thresholds from
+		// the rows below it, so blurring and thresholding run that far ahead.
+		int lookahead = max(detectionDilator.reach(), blendingDilator.reach());
+		int thresholded = 0;
+		for(int y=0; y < rows; y += settings.strip_rows) {
+			int bandEnd = min(rows, y + settings.strip_rows);
+			int needed = min(rows, bandEnd + lookahead);
+			if ( needed > thresholded ) {
+				Range ahead(thresholded, needed);
+				blurRows(ahead);
+				thresholdRows(ahead);
+				thresholded = needed;
+			}
+			dilateRows(Range(y, bandEnd));
+		}
+	}
+
+	// The dilated mask is only expanded to bytes for display, tracing and
+	// comparison
+	if ( showDilated.load() || retainMasks.load() || traceContours )
+		dilatedDetectionBits.unpack(dilatedRegion);
+	retainDebugImage(dilatedDetection, packet.dilatedDetection, showDilated.load() || retainMasks.load()); // findContours modifies its input
+
+	// Bounding boxes of the blobs of motion, and their outlines only when
+	// something will draw them
+	blobExtractor.extract(dilatedDetectionBits, packet.blobs, region.tl());
+	Rect fullFrame(Point(0, 0), packet.sourceFrame.size());
+	packet.rects.resize(packet.blobs.size());
+	for(size_t i=0; i<packet.blobs.size(); i++)
+		packet.rects[i] = toFullResolution(packet.blobs[i].box) & fullFrame;
+
+	if ( traceContours ) {
+		findContours(dilatedRegion, packet.contours, packet.hierarchy, RETR_EXTERNAL, CHAIN_APPROX_NONE, region.tl());
+	} else {
+		packet.contours.clear();
+		packet.hierarchy.clear();
 	}
 }
 
+void VideoProcessor::retainDebugImage(const Mat &image, Mat &copy, bool keep)
+{
+	// Copied into the packet's own buffer, as the original is overwritten by the next frame
+	if ( keep )
+		image.copyTo(copy);
+	else
+		copy.release();
+}
+
+void VideoProcessor::trackFrame(FramePacket &packet)
+{
+	showDebugWindow(packet.sourceFrame, ORIGINAL_INPUT, showOriginal, shownOriginal);
+	showDebugWindow(packet.blurFrame, BLURRED_INPUT, showBlur, shownBlur);
+	showDebugWindow(packet.delta, BACKGROUND_DIFFERENCE, showDelta, shownDelta);
+	showDebugWindow(packet.thresholdedDelta, THRESHOLDED_DELTA, showThreshold, shownThreshold);
+	showDebugWindow(packet.dilatedDetection, DILATED_THRESHOLD, showDilated, shownDilated);
+	showDebugWindow(packet.dilatedBlending, DILATED_BLENDING_THRESHOLD, showDilatedBlending, shownDilatedBlending);
+
+	// The overlay is only rendered when something will display it
+	bool renderOutput = this->showOutput.load() || this->outputImageObserver != nullptr;
+	Mat rectOutput;
+	if ( renderOutput )
+		packet.sourceFrame.copyTo(rectOutput);
+
+	// Correlate and process detected motion
+	const VideoProcessorSnapshot &snapshot = *packet.snapshot;
+	auto correlationStart = chrono::steady_clock::now();
+	packet.updatedEntities = correlate(snapshot, packet.rects, packet.sourceFrame, packet.frameId, packet.frameTime);
+	packet.correlationTime = chrono::duration<double, milli>(chrono::steady_clock::now() - correlationStart).count();
+	detect(snapshot, packet.frameId, packet.sourceFrame);
+	endEntities(snapshot, packet.frameId, &borderRect);
+	if ( renderOutput )
+		paintEntities(snapshot, rectOutput, packet.frameId, packet.frameTime, packet.dFrameTime);
+
+	if ( renderOutput ) {
+		if ( processingScale > 1 ) // contours are found at the processing resolution
+			for(vector<Point> &contour: packet.contours)
+				for(Point &p: contour)
+					p *= processingScale;
+		for(vector<vector<Point>>::size_type i = 0; i< packet.contours.size(); i++ )
+			drawContours( rectOutput, packet.contours, static_cast<int>(i), CONTOUR_COLOUR, 1, 8, packet.hierarchy, 0, Point() );
+	}
+	showDebugWindow(rectOutput, LABELED_OUTPUT, showOutput, shownOutput);
+	showDebugWindow(packet.background, BACKGROUND_FRAME, showBackground, shownBackground);
+
+	if ( this->outputImageObserver != nullptr ) {
+		this->outputImageObserver->renderedImage(&rectOutput);
+	}
+
+	updateStatistics(packet);
+}
+
+void VideoProcessor::updateStatistics(const FramePacket &packet)
+{
+	auto now = chrono::steady_clock::now();
+	chrono::duration<double, milli> latency = now - packet.captureTime;
+
+	lock_guard<mutex> statisticsLock(this->statisticsMutex);
+	VideoProcessorStatistics &st = this->statistics;
+	if ( st.frames == 0 ) {
+		st.latency = latency.count();
+		st.correlationTime = packet.correlationTime;
+		st.updatedEntities = packet.updatedEntities;
+	} else {
+		chrono::duration<double> interval = now - this->lastOutputTime;
+		if ( interval.count() > 0 )
+			st.fps = st.fps == 0 ? 1.0 / interval.count() :
+					 (1.0 - STATISTICS_SMOOTHING) * st.fps + STATISTICS_SMOOTHING / interval.count();
+		st.latency = (1.0 - STATISTICS_SMOOTHING) * st.latency + STATISTICS_SMOOTHING * latency.count();
+		st.correlationTime = (1.0 - STATISTICS_SMOOTHING) * st.correlationTime + STATISTICS_SMOOTHING * packet.correlationTime;
+		st.updatedEntities = (1.0 - STATISTICS_SMOOTHING) * st.updatedEntities + STATISTICS_SMOOTHING * packet.updatedEntities;
+	}
+	st.maxLatency = max(st.maxLatency, latency.count());
+	st.bufferAllocations += packet.bufferAllocations;
+	st.skippedPixels = packet.skippedPixels;
+	st.frames++;
+	this->lastOutputTime = now;
+}
+
+VideoProcessorStatistics VideoProcessor::getStatistics()
+{
+	lock_guard<mutex> statisticsLock(this->statisticsMutex);
+	return this->statistics;
+}
+
+bool VideoProcessor::isShutdownRequested() const
+{
+	return this->shutdownRequested.load();
+}
+
 void VideoProcessor::showDebugWindow(const Mat &image, const char label[], atomic<bool> &control, bool &shown)
 {
-	if ( control.load() ) {
+	if ( control.load() && !image.empty() ) {
 		imshow(label, image);
 		shown  = true;
 	} else if (shown) {
@@ -229,17 +591,17 @@ void VideoProcessor::destroyDebugWindows()
 	destroyDebugWindow(DILATED_BLENDING_THRESHOLD,  this->shownDilatedBlending);
 }
 
-void VideoProcessor::detect(ulong frameId, Mat &frame)
+void VideoProcessor::detect(const VideoProcessorSnapshot &snapshot, ulong frameId, Mat &frame)
 {
-	for(DetectionZone *zone: this->detectionZones) {
+	for(const shared_ptr<const DetectionZone> &zone: snapshot.detectionZones) {
 		for(Entity *e: this->entities) {
 			double ratio = 0;
 			if ( overlaps(e->box, zone->zone, ratio) != OVERLAP_TYPE_NONE ) {
 				bool angleMatch = (!zone->directional) || zone->acceptableAngle(e->getBearingRadians());
 				if ( angleMatch ) {
-					if ( frameId - e->detections[zone] > s.detection_timeout ) {
+					if ( frameId - e->detections[zone] > snapshot.settings.detection_timeout ) {
 						if ( this->detectionObserver )
-							this->detectionObserver->detected(zone, e, frame);
+							this->detectionObserver->detected(zone.get(), e, frame);
 						//cout << "Detected " << e->str() << " " << vel << "km/h " << dir << endl;
 					}
 					e->detections[zone] = frameId;
@@ -249,27 +611,16 @@ void VideoProcessor::detect(ulong frameId, Mat &frame)
 	}
 }
 
-void VideoProcessor::endEntities(ulong frameId, Rect *borderRect)
+void VideoProcessor::endEntities(const VideoProcessorSnapshot &snapshot, ulong frameId, Rect *borderRect)
 {
-	list<Entity*> toRemove;
-	for(Entity *e: this->entities) {
-		if ( (e->lastUpdateFrameId < frameId && e->bbHistory.size() == 1) ||  // remove blips
-			 (e->lastUpdateFrameId + s.entity_timeout < frameId ) ) {  // unmatched for entity_timeout frames
-			toRemove.push_back(e);
-			continue;
-		}
-
-		if ( sharesBorders(&e->box, borderRect, s.borderWidth) ) {
-			toRemove.push_back(e);
-		}
-	}
-	for(Entity *e: toRemove) {
-		this->entities.remove(e); // warning O(n)
-		delete e;
-	}
+	this->entities.removeIf([&](Entity *e) {
+		return (e->lastUpdateFrameId < frameId && e->bbHistory.size() == 1) ||  // remove blips
+			   (e->lastUpdateFrameId + snapshot.settings.entity_timeout < frameId ) ||  // unmatched for entity_timeout frames
+			   sharesBorders(&e->box, borderRect, snapshot.settings.borderWidth);
+	});
 }
 
-void VideoProcessor::paintEntities(Mat &paint, ulong frameId, double frameTime, double dFrameTime)
+void VideoProcessor::paintEntities(const VideoProcessorSnapshot &snapshot, Mat &paint, ulong frameId, double frameTime, double dFrameTime)
 {
 	for(Entity *e: this->entities) {
 		ostringstream str;
@@ -292,15 +643,17 @@ void VideoProcessor::paintEntities(Mat &paint, ulong frameId, double frameTime,
 
 		cv::putText(paint, str.str(), Point(e->box.x, e->box.y + e->box.height+5), FONT_HERSHEY_COMPLEX_SMALL, 0.5, Scalar(255,255,255));
 	}
-	for(DetectionZone *r: detectionZones) {
-		paintDetectionZone(paint, r);
+	for(const shared_ptr<const DetectionZone> &r: snapshot.detectionZones) {
+		paintDetectionZone(paint, r.get());
 	}
-	for(Rect *r: maskZones) {
-		rectangle(paint, *r, MASK_ZONE_COLOUR);
+	for(const Rect &r: snapshot.maskZones) {
+		rectangle(paint, r, MASK_ZONE_COLOUR);
 	}
+	if ( !snapshot.maskPolygons.empty() )
+		polylines(paint, snapshot.maskPolygons, true, MASK_ZONE_COLOUR);
 }
 
-void VideoProcessor::paintDetectionZone(Mat &paint, DetectionZone *z)
+void VideoProcessor::paintDetectionZone(Mat &paint, const DetectionZone *z)
 {
 	rectangle(paint, z->zone, DETECTION_ZONE_COLOUR);
 
@@ -326,44 +679,125 @@ void VideoProcessor::paintDetectionZone(Mat &paint, DetectionZone *z)
 	line(paint, Point(x,y), Point(x3, y3), DETECTION_ZONE_COLOUR);
 }
 
-void VideoProcessor::performBackgroundBlending(Mat& frame, Mat& baseFrame, Mat& delta, uint thresholdTime[])
+void VideoProcessor::performBackgroundBlending(Mat& frame, Mat& baseFrame, ushort thresholdTime[], const Rect &region,
+											   const VideoProcessorDetectionSettings &settings)
 {
-	int frameLength = delta.rows * delta.cols * delta.channels();
-
-	Mat blendingThreshold;
-	threshold(delta, blendingThreshold, s.blending_threshold, 255, THRESH_BINARY);
-
+	CV_Assert( frame.isContinuous() && baseFrame.isContinuous() );
+
+	// Only unmasked spans are blended.  Each stripe counts its own foreground
+	// and blended pixels, which are summed for the overload check once all
+	// stripes are done.
+	BackgroundBlender blender(settings.background_blend_ratio, settings.foreground_blend_ratio, settings.threshold_timeout);
+	size_t channels = frame.channels();
+	size_t rowLength = frame.cols * channels;
+	atomic<size_t> threshCount{0};
+	atomic<size_t> blended{0};
+	forEachStripe(region.height, [&](const Range &r) {
+		size_t count = 0;
+		size_t length = 0;
+		for(int y=region.y + r.start; y < region.y + r.end; y++) {
+			maskMap.forEachSpan(y, region.x, region.br().x, [&](int start, int end) {
+				size_t offset = y * rowLength + start * channels;
+				size_t spanLength = (end - start) * channels;
+				count += blender.blend(baseFrame.data + offset, frame.data + offset, dilatedBlending.data + offset,
+									   thresholdTime + offset, spanLength);
+				length += spanLength;
+			});
+		}
+		threshCount += count;
+		blended += length;
+	});
+
+	// An overloaded background restarts from the frame, copied rather than
+	// swapped in as the frame is still in use downstream.  Only the unmasked
+	// spans are copied, as a blurred frame is not blurred in masked rows.
+	if ( threshCount > settings.foreground_overload_level * blended ) {
+		for(int y=region.y; y < region.br().y; y++) {
+			maskMap.forEachSpan(y, region.x, region.br().x, [&](int start, int end) {
+				size_t offset = y * rowLength + start * channels;
+				memcpy(baseFrame.data + offset, frame.data + offset, (end - start) * channels);
+			});
+		}
+	}
+}
 
-	Mat dilateBlendingKernel = getStructuringElement(MORPH_ELLIPSE,
-													 Size(2*s.dilateBlendingFactor, 2*s.dilateBlendingFactor),
-													 Point(s.dilateBlendingFactor,s.dilateBlendingFactor)
-													 );
+Rect VideoProcessor::processingRegion(const VideoProcessorSnapshot &snapshot, const Rect &frameRect,
+									  const vector<Rect> &masks) const
+{
+	const VideoProcessorDetectionSettings &settings = snapshot.settings;
+	if ( !settings.restrict_to_zones || snapshot.detectionZones.empty() )
+		return frameRect;
+
+	// The detection zones and the margin in which entities approach them
+	Rect zones = snapshot.detectionZones.front()->zone;
+	for(const shared_ptr<const DetectionZone> &z: snapshot.detectionZones)
+		zones |= z->zone;
+	int margin = max(0, settings.zone_margin);
+	zones = Rect(zones.x - margin, zones.y - margin, zones.width + 2*margin, zones.height + 2*margin);
+	Rect region = toProcessingResolution(zones) & frameRect;
+
+	// Less any mask zone covering a whole edge of it.  Trimming one edge can
+	// leave another mask zone covering the new edge, so repeat until none do.
+	bool trimmed = true;
+	while ( trimmed && region.area() > 0 ) {
+		trimmed = false;
+		for(const Rect &m: masks) {
+			Rect cover = m & region;
+			if ( cover.area() == 0 )
+				continue;
+			if ( cover == region )
+				return Rect();
+			Rect next = region;
+			if ( cover.width == region.width && cover.y == region.y )
+				next = Rect(Point(region.x, cover.br().y), region.br());
+			else if ( cover.width == region.width && cover.br().y == region.br().y )
+				next = Rect(region.tl(), Point(region.br().x, cover.y));
+			else if ( cover.height == region.height && cover.x == region.x )
+				next = Rect(Point(cover.br().x, region.y), region.br());
+			else if ( cover.height == region.height && cover.br().x == region.br().x )
+				next = Rect(region.tl(), Point(cover.x, region.br().y));
+			if ( next != region ) {
+				region = next;
+				trimmed = true;
+			}
+		}
+	}
+	return region;
+}
 
-	Mat dilatedBlending;
-	dilate(blendingThreshold, dilatedBlending, dilateBlendingKernel);
+Rect VideoProcessor::toProcessingResolution(const Rect &r) const
+{
+	// Rounded outwards, so that a reduced pixel is covered if any part of it was
+	int s = processingScale;
+	return Rect(Point(r.x / s, r.y / s), Point((r.x + r.width + s - 1) / s, (r.y + r.height + s - 1) / s));
+}
 
-	showDebugWindow(dilatedBlending, DILATED_BLENDING_THRESHOLD, showDilatedBlending, shownDilatedBlending);
+Rect VideoProcessor::toFullResolution(const Rect &r) const
+{
+	int s = processingScale;
+	return Rect(r.x * s, r.y * s, r.width * s, r.height * s);
+}
 
-	int threshCount = 0;
-	for(int x=0; x < frameLength; x++) {
-		if(!dilatedBlending.data[x]) {
-			thresholdTime[x] = 0;
-			baseFrame.data[x] = static_cast<uchar>(
-						(1.0f-s.background_blend_ratio) * baseFrame.data[x] +
-						s.background_blend_ratio * frame.data[x]);
-		} else {
-			thresholdTime[x]++;
-			threshCount++;
-			if ( thresholdTime[x] > s.threshold_timeout )
-				baseFrame.data[x] = static_cast<uchar>(
-							(1.0f-s.foreground_blend_ratio) * baseFrame.data[x] +
-							s.foreground_blend_ratio * frame.data[x]);
+void VideoProcessor::configureStripes(int pixelThreads)
+{
+	unsigned threads = pixelThreads == 0 ? max(1u, thread::hardware_concurrency()) : static_cast<unsigned>(max(1, pixelThreads));
+	if ( threads == 1 )
+		stripePool.reset();
+	else if ( !stripePool || stripePool->size() != threads - 1 )
+		stripePool.reset(new WorkerPool(threads - 1));
+}
 
-		}
+void VideoProcessor::forEachStripe(int rows, const function<void(const Range&)> &body)
+{
+	if ( !stripePool ) {
+		body(Range(0, rows));
+		return;
 	}
 
-	if ( threshCount > s.foreground_overload_level * frameLength )
-		baseFrame = frame;
+	size_t stripes = stripePool->size() + 1;
+	stripePool->parallelFor(stripes, [&](size_t i) {
+		body(Range(static_cast<int>(rows * i / stripes), static_cast<int>(rows * (i + 1) / stripes)));
+	});
 }
 
 bool VideoProcessor::sharesBorders(Rect *r1, Rect *r2, int w)
@@ -376,177 +810,271 @@ bool VideoProcessor::sharesBorders(Rect *r1, Rect *r2, int w)
 
 void VideoProcessor::requestShutdown(bool shutdown)
 {
-	lock_guard<mutex> datastructureLock(this->dsMutex);
 	this->shutdownRequested.store(shutdown);
 }
 
-void VideoProcessor::correlate(vector<Rect>& rects, Mat& frame,  ulong frameId, double frameTime)
+// Any rect that overlaps() finds touching r lies partly within this, as
+// contains() includes the far edges
+static Rect overlapBounds(const Rect &r)
 {
-	map<Rect*, list<tuple<Entity*, OverlapType, double>>> rectOverlaps;
-	map<Entity*, list<tuple<Rect*, OverlapType, double>>> entityOverlaps;
-
-	Rect borderRect(0, 0, frame.cols, frame.rows);
+	return Rect(r.x, r.y, r.width + 1, r.height + 1);
+}
 
-	for(vector<Rect>::size_type i=0; i<rects.size(); i++) {
-		Rect *bb = &rects[i];
+// The point overlaps() measures distances from
+static Point overlapCentre(const Rect &r)
+{
+	return Point(static_cast<int>(floor(r.x - r.width/2.0)), static_cast<int>(floor(r.y - r.height/2.0)));
+}
 
-		for(Entity *e: entities) {
-			double overlap = 0;
+// A rect apart from r only scores over 0.75 in overlaps() when its centre is
+// nearer r's than twice the square root of the smaller area
+static Rect distanceGate(const Rect &r)
+{
+	int reach = static_cast<int>(ceil(2 * sqrt(max(0, r.area())))) + 1;
+	Point c = overlapCentre(r);
+	return Rect(c.x - reach, c.y - reach, 2*reach + 1, 2*reach + 1);
+}
 
-			Rect dr = e->deadRecon(frameTime);
-			OverlapType o = overlaps(*bb, dr, overlap);
+double VideoProcessor::correlate(const VideoProcessorSnapshot &snapshot, vector<Rect>& rects, Mat& frame,  ulong frameId, double frameTime)
+{
+	Rect borderRect(0, 0, frame.cols, frame.rows);
 
-			if ( o != OVERLAP_TYPE_NONE || overlap > 0.75) {
-				rectOverlaps[bb].push_back(tuple<Entity*, OverlapType, double>(e, o, overlap));
-				entityOverlaps[e].push_back(tuple<Rect*, OverlapType, double>(bb, o, overlap));
+	// Entities are predicted once, and filed in a grid under their overlap
+	// bounds and distance gate; rects are filed under their overlap bounds
+	// and centre.  A rect and entity that could match then share a cell.
+	correlated.assign(entities.begin(), entities.end());
+	int tracked = static_cast<int>(correlated.size());
+	predicted.clear();
+	predictedScorer.clear();
+	entityGrid.reset(frame.size(), CORRELATION_CELL_SIZE);
+	auto fileEntity = [this](const Rect &dr) {
+		int item = static_cast<int>(predicted.size());
+		predicted.push_back(dr);
+		predictedScorer.add(dr);
+		entityGrid.insert(overlapBounds(dr), item);
+		entityGrid.insert(distanceGate(dr), item);
+	};
+	for(Entity *e: correlated)
+		fileEntity(e->deadRecon(frameTime));
+	rectGrid.reset(frame.size(), CORRELATION_CELL_SIZE);
+	for(size_t i=0; i<rects.size(); i++) {
+		rectGrid.insert(overlapBounds(rects[i]), static_cast<int>(i));
+		rectGrid.insert(Rect(overlapCentre(rects[i]), Size(1, 1)), static_cast<int>(i));
+	}
+	candidateStamp.assign(correlated.size(), -1);
+
+	// Every plausible rect and entity pair, in the order they were found.
+	// The entities near each rect are gathered first and scored together.
+	candidates.clear();
+	for(int i=0; i < static_cast<int>(rects.size()); i++) {
+		const Rect &bb = rects[i];
+		bool matched = false;
+
+		nearbyEntities.clear();
+		auto gather = [&](int item) {
+			if ( candidateStamp[item] != i ) {
+				candidateStamp[item] = i;
+				nearbyEntities.push_back(item);
+			}
+		};
+		entityGrid.query(overlapBounds(bb), gather);
+		entityGrid.query(Rect(overlapCentre(bb), Size(1, 1)), gather);
+		predictedScorer.score(bb, nearbyEntities, nearbyTypes, nearbyRatios);
+		for(size_t k=0; k < nearbyEntities.size(); k++) {
+			if ( nearbyTypes[k] != OVERLAP_TYPE_NONE || nearbyRatios[k] > 0.75) {
+				candidates.push_back(Candidate{nearbyEntities[k], i, nearbyTypes[k], nearbyRatios[k]});
+				matched = true;
 			}
 		}
 
-		if ( rectOverlaps[bb].empty() && !sharesBorders(bb, &borderRect, s.borderWidth)) {
-			Entity *e = new Entity(*bb, frameId);
+		if ( !matched && !sharesBorders(&rects[i], &borderRect, snapshot.settings.borderWidth)) {
+			Entity *e = this->entities.create(rects[i], frameId);
 			//cout << "  Created new Entity " << e->str() << endl;
-			this->entities.push_back(e);
-			rectOverlaps[bb].push_back(tuple<Entity*, OverlapType, double>(e, OVERLAP_TYPE_OVERLAPS, 1.0));
-			for(uint j=0; j<=i; j++) {
+			int item = static_cast<int>(correlated.size());
+			correlated.push_back(e);
+			candidateStamp.push_back(-1);
+			fileEntity(e->box);
+
+			// The rects so far that the new entity touches, in order
+			nearbyRects.clear();
+			auto nearby = [&](int j) {
+				if ( j <= i )
+					nearbyRects.push_back(j);
+			};
+			rectGrid.query(overlapBounds(e->box), nearby);
+			rectGrid.query(distanceGate(e->box), nearby);
+			sort(nearbyRects.begin(), nearbyRects.end());
+			nearbyRects.erase(unique(nearbyRects.begin(), nearbyRects.end()), nearbyRects.end());
+			for(int j: nearbyRects) {
 				double overlap = 0;
-				Rect *bbj = &rects[j];
-				OverlapType o = overlaps(*bbj, e->box, overlap);
-				if ( o != OVERLAP_TYPE_NONE || overlap > 0.75) {
-					rectOverlaps[bbj].push_back(tuple<Entity*, OverlapType, double>(e, o, overlap));
-					entityOverlaps[e].push_back(tuple<Rect*, OverlapType, double>(bbj, OVERLAP_TYPE_OVERLAPS, 1.0));
-				}
+				OverlapType o = overlaps(rects[j], e->box, overlap);
+				if ( o != OVERLAP_TYPE_NONE || overlap > 0.75)
+					candidates.push_back(Candidate{item, j, OVERLAP_TYPE_OVERLAPS, 1.0});
 			}
 		}
 	}
 
-
-	map<Rect*, list<tuple<Entity*, OverlapType, double>*>> bestMatch;
-
-	for(auto it:  entityOverlaps) {
-		// todo convert to pointers
-		tuple<Rect*, OverlapType, double> bestOverlap(nullptr, OVERLAP_TYPE_NONE, 0);
-		double bestConfidence = 0;
-
-		for(tuple<Rect*, OverlapType, double> overlap: it.second) {
-			double confidence = 0;
-			switch(get<1>(overlap)) {
-			case OVERLAP_TYPE_CONTAINS:
-				confidence = get<2>(overlap);
-				break;
-			case OVERLAP_TYPE_CONTAINED:
-				confidence = get<2>(overlap);
-				break;
-			case OVERLAP_TYPE_OVERLAPS:
-				confidence = get<2>(overlap);
-				break;
-			case OVERLAP_TYPE_NONE:
-				confidence = get<2>(overlap) / 2;
-				break;
-			default:
-				throw invalid_argument("Overlap Type Unknown");
-			}
-			if ( confidence > bestConfidence ) {
-				bestConfidence = confidence;
-				bestOverlap = overlap;
-			}
+	// Each entity takes the first of its most confident rects
+	bestCandidate.assign(correlated.size(), -1);
+	bestConfidence.assign(correlated.size(), 0);
+	for(int c=0; c < static_cast<int>(candidates.size()); c++) {
+		const Candidate &overlap = candidates[c];
+		double confidence = matchConfidence(overlap.type, overlap.overlap);
+		if ( confidence > bestConfidence[overlap.entity] ) {
+			bestConfidence[overlap.entity] = confidence;
+			bestCandidate[overlap.entity] = c;
 		}
+	}
 
-		if ( get<0>(bestOverlap) != nullptr ) {
-			bestMatch[get<0>(bestOverlap)].push_back(new tuple<Entity*, OverlapType, double>(it.first, get<1>(bestOverlap), get<2>(bestOverlap)));
+	// The greedy engine updates entities from rects that they alone chose.
+	// The optimal engine gives each rect to at most one of the entities it
+	// is a candidate for, so that a merged blob still updates one of them.
+	updatingCandidate.assign(correlated.size(), -1);
+	if ( snapshot.settings.assign_engine == ASSIGN_OPTIMAL ) {
+		assigner.reset(static_cast<int>(correlated.size()), static_cast<int>(rects.size()));
+		for(const Candidate &overlap: candidates)
+			assigner.add(overlap.entity, overlap.rect, matchConfidence(overlap.type, overlap.overlap));
+		assigner.solve();
+		for(size_t i=0; i < correlated.size(); i++)
+			updatingCandidate[i] = assigner.assigned(static_cast<int>(i));
+	} else {
+		matchesPerRect.assign(rects.size(), 0);
+		for(int c: bestCandidate)
+			if ( c >= 0 )
+				matchesPerRect[candidates[c].rect]++;
+		for(size_t i=0; i < correlated.size(); i++) {
+			int c = bestCandidate[i];
+			if ( c >= 0 && matchesPerRect[candidates[c].rect] == 1 )
+				updatingCandidate[i] = c;
 		}
 	}
 
-	for(pair<Rect*, list<tuple<Entity*, OverlapType, double>*>> matchSet: bestMatch) {
-		if ( matchSet.second.size() == 1 ) {
-			get<0>(*matchSet.second.front())->update(matchSet.first, frameId, frameTime);
-		}
-		for(tuple<Entity*, OverlapType, double>* match: matchSet.second) {
-			Entity *e = get<0>(*match);
-			if ( e->id == 0 && e->bbHistory.size() > 1 ) // don't assign IDs to blips
-				e->assignId(this->entityIdCounter++);
-			delete match;
+	// Matches are visited rect by rect, so that ids are given out in the
+	// order of the rects
+	matchOrder.clear();
+	for(size_t i=0; i < correlated.size(); i++)
+		if ( bestCandidate[i] >= 0 )
+			matchOrder.push_back(static_cast<int>(i));
+	auto orderingRect = [this](int i) {
+		return candidates[updatingCandidate[i] >= 0 ? updatingCandidate[i] : bestCandidate[i]].rect;
+	};
+	sort(matchOrder.begin(), matchOrder.end(), [&orderingRect](int a, int b) {
+		int ra = orderingRect(a);
+		int rb = orderingRect(b);
+		return ra != rb ? ra < rb : a < b;
+	});
+	int updated = 0;
+	for(int i: matchOrder) {
+		Entity *e = correlated[i];
+		int c = updatingCandidate[i];
+		if ( c >= 0 ) {
+			e->update(&rects[candidates[c].rect], frameId, frameTime, snapshot.settings.motion_model);
+			if ( i < tracked )
+				updated++;
 		}
+		if ( e->id == 0 && e->bbHistory.size() > 1 ) // don't assign IDs to blips
+			e->assignId(this->entityIdCounter++);
 	}
+	return tracked > 0 ? static_cast<double>(updated) / tracked : 1.0;
 }
 
-bool VideoProcessor::contains(const Rect &r, Point2i p)
+double VideoProcessor::matchConfidence(OverlapType type, double overlap)
 {
-	int xl = r.x;
-	int xh = r.x + r.width;
-	int yl = r.y;
-	int yh = r.y + r.width;
-
-	return p.x >= xl && p.x <= xh && p.y >= yl && p.y <= yh;
+	switch(type) {
+	case OVERLAP_TYPE_CONTAINS:
+	case OVERLAP_TYPE_CONTAINED:
+	case OVERLAP_TYPE_OVERLAPS:
+		return overlap;
+	case OVERLAP_TYPE_NONE:
+		return overlap / 2;
+	default:
+		throw invalid_argument("Overlap Type Unknown");
+	}
 }
 
-void VideoProcessor::addDetectionZone(const DetectionZone &z)
+bool VideoProcessor::contains(const Rect &r, Point2i p)
 {
-	lock_guard<mutex> datastructureLock(this->dsMutex);
-	this->detectionZones.push_back(new DetectionZone(z));
+	return OverlapScorer::contains(r, p);
 }
 
-void VideoProcessor::removeDetectionZones(const function<bool(DetectionZone*)> &test)
+shared_ptr<const VideoProcessorSnapshot> VideoProcessor::currentSnapshot() const
 {
-	lock_guard<mutex> datastructureLock(this->dsMutex);
-	this->detectionZones.remove_if(test);
+	return atomic_load(&this->snapshot);
 }
 
-void VideoProcessor::addMaskZone(const Rect &r)
+void VideoProcessor::publish(const function<void(VideoProcessorSnapshot&)> &edit)
 {
 	lock_guard<mutex> datastructureLock(this->dsMutex);
-	this->maskZones.push_back(new Rect(r));
+	shared_ptr<VideoProcessorSnapshot> next = make_shared<VideoProcessorSnapshot>(*atomic_load(&this->snapshot));
+	edit(*next);
+	next->version++;
+	atomic_store(&this->snapshot, shared_ptr<const VideoProcessorSnapshot>(next));
 }
 
-void VideoProcessor::removeMaskZones(const function<bool(Rect*)> &test)
+void VideoProcessor::addDetectionZone(const DetectionZone &z)
 {
-	lock_guard<mutex> datastructureLock(this->dsMutex);
-	this->maskZones.remove_if(test);
+	publish([&z](VideoProcessorSnapshot &next) {
+		next.detectionZones.push_back(make_shared<const DetectionZone>(z));
+	});
 }
 
-VideoProcessorDetectionSettings* VideoProcessor::getCurrentConfiguration()
+void VideoProcessor::removeDetectionZones(const function<bool(const DetectionZone*)> &test)
 {
-	lock_guard<mutex> datastructureLock(this->dsMutex);
-	return new VideoProcessorDetectionSettings(s);
+	publish([&test](VideoProcessorSnapshot &next) {
+		auto &zones = next.detectionZones;
+		zones.erase(remove_if(zones.begin(), zones.end(), [&test](const shared_ptr<const DetectionZone> &z) {
+			return test(z.get());
+		}), zones.end());
+	});
 }
 
-void VideoProcessor::setCurrentConfiguration(VideoProcessorDetectionSettings *newSettings)
+void VideoProcessor::addMaskZone(const Rect &r)
 {
-	lock_guard<mutex> datastructureLock(this->dsMutex);
-	this->s = *newSettings;
+	publish([&r](VideoProcessorSnapshot &next) {
+		next.maskZones.push_back(r);
+	});
 }
 
-VideoProcessor::OverlapType VideoProcessor::overlaps(const Rect& r, const Rect& e, double &overlapRatio)
+void VideoProcessor::addMaskPolygon(const vector<Point> &polygon)
 {
-	bool etl = contains(e, r.tl());//e.contains(r.tl());
-	bool ebr = contains(e, r.br());//e.contains(r.br());
-	bool rtl = contains(r, e.tl());//r.contains(e.tl());
-	bool rbr = contains(r, e.br());//r.contains(e.br());
-
-	double ea = e.area();
-	double ra = r.area();
+	publish([&polygon](VideoProcessorSnapshot &next) {
+		next.maskPolygons.push_back(polygon);
+	});
+}
 
-	if ( !etl && !ebr && !rtl && !rbr ) {
-		Point2d rc = Point2d((-r.width/2.0) + r.x, (-r.height/2.0) + r.y);
-		Point2d ec = Point2d((-e.width/2.0) + e.x, (-e.height/2.0) + e.y);
-		double dist = sqrt( (rc.x - ec.x)*(rc.x - ec.x) + (rc.y - ec.y)*(rc.y - ec.y));
+void VideoProcessor::removeMaskZones(const function<bool(const Rect*)> &test)
+{
+	publish([&test](VideoProcessorSnapshot &next) {
+		auto &zones = next.maskZones;
+		zones.erase(remove_if(zones.begin(), zones.end(), [&test](const Rect &r) {
+			return test(&r);
+		}), zones.end());
+	});
+}
 
-		double areaCorrelation = 1 - (abs(ea-ra)/(ea+ra));
-		double distCorrelation = sqrt(min(ea, ra)) / dist;
-		overlapRatio = areaCorrelation * 0.50 + distCorrelation * 0.50;
-		return OVERLAP_TYPE_NONE;
-	}
+void VideoProcessor::removeMaskPolygons(const function<bool(const vector<Point>*)> &test)
+{
+	publish([&test](VideoProcessorSnapshot &next) {
+		auto &polygons = next.maskPolygons;
+		polygons.erase(remove_if(polygons.begin(), polygons.end(), [&test](const vector<Point> &p) {
+			return test(&p);
+		}), polygons.end());
+	});
+}
 
-	if ( etl && ebr ) {
-		overlapRatio = ra/ea;
-		return OVERLAP_TYPE_CONTAINED;
-	}
+VideoProcessorDetectionSettings* VideoProcessor::getCurrentConfiguration()
+{
+	return new VideoProcessorDetectionSettings(currentSnapshot()->settings);
+}
 
-	if ( rtl && rbr ) {
-		overlapRatio = ea/ra;
-		return OVERLAP_TYPE_CONTAINS;
-	}
+void VideoProcessor::setCurrentConfiguration(VideoProcessorDetectionSettings *newSettings)
+{
+	publish([newSettings](VideoProcessorSnapshot &next) {
+		next.settings = *newSettings;
+	});
+}
 
-	double oa = (r&e).area();
-	overlapRatio = oa / (ea + ra - oa);
-	return OVERLAP_TYPE_OVERLAPS;
+OverlapType VideoProcessor::overlaps(const Rect& r, const Rect& e, double &overlapRatio)
+{
+	return OverlapScorer::overlaps(r, e, overlapRatio);
 }
@@ -24,10 +24,26 @@
 #include <mutex>
 #include <opencv2/opencv.hpp>
 #include <atomic>
+#include <memory>
+#include <chrono>
 
 #include "entity.h"
+#include "entitypool.h"
 #include "detectionzone.h"
 #include "videoprocessordetectionsettings.h"
+#include "framesource.h"
+#include "framepacket.h"
+#include "framesmoother.h"
+#include "framedilator.h"
+#include "bitmask.h"
+#include "maskmap.h"
+#include "blobextractor.h"
+#include "videoprocessorstatistics.h"
+#include "videoprocessorsnapshot.h"
+#include "workerpool.h"
+#include "rectgrid.h"
+#include "rectassigner.h"
+#include "overlapscorer.h"
 
 namespace cvqm {
 	class VideoProcessor;
@@ -38,7 +54,7 @@ namespace cvqm {
 class cvqm::DetectionObserver
 {
 public:
-	virtual void detected(DetectionZone *zone, Entity *e, cv::Mat &frame) = 0;
+	virtual void detected(const DetectionZone *zone, Entity *e, cv::Mat &frame) = 0;
 	virtual ~DetectionObserver();
 };
 
@@ -52,34 +68,113 @@ public:
 class cvqm::VideoProcessor
 {
 private:
-	enum OverlapType {
-		OVERLAP_TYPE_NONE = 0,
-		OVERLAP_TYPE_CONTAINS = 1,
-		OVERLAP_TYPE_CONTAINED = 2,
-		OVERLAP_TYPE_OVERLAPS = 4
-	};
-
+	// Serialises edits; readers use the published snapshot without locking
 	std::mutex dsMutex;
-	std::list<Entity*> entities;
-	std::list<DetectionZone*> detectionZones;
-	std::list<cv::Rect*> maskZones;
-	uint *thresholdTime = nullptr;
+	std::shared_ptr<const VideoProcessorSnapshot> snapshot;
+	void publish(const std::function<void(VideoProcessorSnapshot&)> &edit);
+	std::shared_ptr<const VideoProcessorSnapshot> currentSnapshot() const;
+
+	EntityPool entities;
+	ushort *thresholdTime = nullptr;  // frames each pixel has been foreground, saturating
 
 	int device_id = 0;
 	int xRes = 640;
 	int yRes = 480;
+	std::string inputFile;
+	double inputFps = 0;
 
 	ulong entityIdCounter = 0;
 	ulong frameIdCounter = 0;
 
-	cvqm::VideoProcessorDetectionSettings s;
-
-	void performBackgroundBlending(cv::Mat& frame, cv::Mat& baseFrame, cv::Mat& delta, uint thresholdTime[]);
-	void detect(ulong frameid, cv::Mat& frame);
-	void correlate(std::vector<cv::Rect> &rects, cv::Mat& frame, ulong frameId, double frameTime);
-	void endEntities(ulong frameId, cv::Rect *borderRect);
-	void paintEntities(cv::Mat &paint, ulong frameId, double frameTime, double dFrameTime);
-	void paintDetectionZone(cv::Mat &paint, DetectionZone *z);
+	// Frames in flight between each pair of pipeline stages, and in total
+	static constexpr size_t PIPELINE_DEPTH = 2;
+	static constexpr size_t PACKET_COUNT = 2 * PIPELINE_DEPTH + 3;
+
+	// Capture stage state
+	std::unique_ptr<FrameSource> source;
+	bool greyscale = true;
+	int processingScale = 1;  // frames are reduced by this factor before detection
+	double lastFrameTime = 0;
+	void convertFrame(const cv::Mat &source, cv::Mat &scaled, cv::Mat &frame);
+
+	// Pixel stage state, and its working buffers which are kept from frame
+	// to frame so that they are only allocated once
+	cv::Mat backgroundFrame;
+	bool backgroundBlurred = false;
+	cv::Mat blurBaseFrame;
+	FrameSmoother smoother;
+	FrameDilator detectionDilator;
+	FrameDilator blendingDilator;
+	cv::Mat detectionThreshold;
+	cv::Mat dilatedDetection;
+	// The detection masks packed a bit per pixel, over the processing region
+	BitMask detectionBits;
+	BitMask dilatedDetectionBits;
+	cv::Mat blendingThreshold;
+	cv::Mat dilatedBlending;
+	MaskMap maskMap;
+	BlobExtractor blobExtractor;
+	cv::Rect processedRegion;
+	cv::Rect processingRegion(const VideoProcessorSnapshot &snapshot, const cv::Rect &frameRect,
+							  const std::vector<cv::Rect> &masks) const;
+	void detectRegion(FramePacket &packet, const cv::Rect &region, bool keepDelta, bool traceContours);
+	void retainDebugImage(const cv::Mat &image, cv::Mat &copy, bool keep);
+
+	// The per-pixel passes are split into row stripes, one per pixel
+	// thread; the pixel stage's own thread works on the first stripe
+	std::unique_ptr<WorkerPool> stripePool;
+	void configureStripes(int pixelThreads);
+	void forEachStripe(int rows, const std::function<void(const cv::Range&)> &body);
+
+	// Tracking stage state.  Tracking works at the capture resolution, and
+	// detection at the processing resolution.
+	cv::Rect borderRect;
+	cv::Rect toProcessingResolution(const cv::Rect &r) const;
+	cv::Rect toFullResolution(const cv::Rect &r) const;
+
+	// Correlation state, rebuilt each frame.  Entities are indexed by their
+	// position in correlated, and rects by theirs in the frame's rects.
+	static constexpr int CORRELATION_CELL_SIZE = 32;
+	std::vector<Entity*> correlated;
+	std::vector<cv::Rect> predicted;
+	std::vector<int> candidateStamp;  // the last rect each entity was tested against
+	std::vector<int> nearbyEntities;
+	std::vector<int> nearbyRects;
+	OverlapScorer predictedScorer;  // the predicted boxes, scored a rect at a time
+	std::vector<OverlapType> nearbyTypes;
+	std::vector<double> nearbyRatios;
+	struct Candidate {
+		int entity;
+		int rect;
+		OverlapType type;
+		double overlap;
+	};
+	std::vector<Candidate> candidates;
+	std::vector<int> bestCandidate;
+	std::vector<double> bestConfidence;
+	std::vector<int> matchesPerRect;
+	std::vector<int> updatingCandidate;  // the candidate each entity is updated from, or -1
+	std::vector<int> matchOrder;
+	RectGrid entityGrid;
+	RectGrid rectGrid;
+	RectAssigner assigner;
+	static double matchConfidence(OverlapType type, double overlap);
+
+	// Smoothing factor for the running fps and latency averages
+	static constexpr double STATISTICS_SMOOTHING = 0.05;
+	std::mutex statisticsMutex;
+	VideoProcessorStatistics statistics;
+	std::chrono::steady_clock::time_point lastOutputTime;
+	void updateStatistics(const FramePacket &packet);
+
+	void performBackgroundBlending(cv::Mat& frame, cv::Mat& baseFrame, ushort thresholdTime[], const cv::Rect &region,
+								   const VideoProcessorDetectionSettings &settings);
+	void detect(const VideoProcessorSnapshot &snapshot, ulong frameid, cv::Mat& frame);
+	// Returns the fraction of the entities already tracked that a rect updated
+	double correlate(const VideoProcessorSnapshot &snapshot, std::vector<cv::Rect> &rects, cv::Mat& frame, ulong frameId, double frameTime);
+	void endEntities(const VideoProcessorSnapshot &snapshot, ulong frameId, cv::Rect *borderRect);
+	void paintEntities(const VideoProcessorSnapshot &snapshot, cv::Mat &paint, ulong frameId, double frameTime, double dFrameTime);
+	void paintDetectionZone(cv::Mat &paint, const DetectionZone *z);
 	bool sharesBorders(cv::Rect *r1, cv::Rect *r2, int w);
 	void destroyDebugWindows();
 	void showDebugWindow(const cv::Mat &image, const char label[], std::atomic<bool> &control, bool &shown);
@@ -113,13 +208,19 @@ public:
 	std::atomic<bool> showDilatedBlending{false};
 	std::atomic<bool> showOutput{false};
 
+	// Keeps each packet's dilated detection mask, as showDilated does,
+	// without showing it
+	std::atomic<bool> retainMasks{false};
+
 	static bool contains(const cv::Rect &r, cv::Point2i p);
 	static OverlapType overlaps(const cv::Rect& r, const cv::Rect& e, double& overlapRatio);
 
 	void addDetectionZone(const DetectionZone &z);
 	void addMaskZone(const cv::Rect &r);
-	void removeDetectionZones(const std::function<bool(DetectionZone*)> &test);
-	void removeMaskZones(const std::function<bool(cv::Rect*)> &test);
+	void addMaskPolygon(const std::vector<cv::Point> &polygon);
+	void removeDetectionZones(const std::function<bool(const DetectionZone*)> &test);
+	void removeMaskZones(const std::function<bool(const cv::Rect*)> &test);
+	void removeMaskPolygons(const std::function<bool(const std::vector<cv::Point>*)> &test);
 	VideoProcessorDetectionSettings *getCurrentConfiguration();
 	void setCurrentConfiguration(VideoProcessorDetectionSettings *);
 
@@ -128,8 +229,22 @@ public:
 
 	void run();
 	void requestShutdown(bool shutdown = true);
+	bool isShutdownRequested() const;
+
+	// Stages of run(), for callers that schedule frames themselves.  open()
+	// must succeed first; each frame then passes through captureFrame(),
+	// processPixels() and trackFrame() in order, one stage at a time.
+	bool open();
+	bool captureFrame(FramePacket &packet);
+	void processPixels(FramePacket &packet);
+	void trackFrame(FramePacket &packet);
+	void close();
+	VideoProcessorStatistics getStatistics();
+
 	void setDeviceId(int id);
 	void setResolution(int xRes, int yRes);
+	void setInputFile(const std::string &path, double nominalFps = 0);
+	ulong getFrameCount() const;
 
 	OutputImageObserver *outputImageObserver = nullptr;
 	DetectionObserver *detectionObserver = nullptr;
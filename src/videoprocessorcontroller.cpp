@@ -84,7 +84,7 @@ QImage VideoProcessorController::matToQImage(const Mat *image)
 				}, data);
 }
 
-void VideoProcessorController::detected(cvqm::DetectionZone *zone, cvqm::Entity *e, Mat &frame)
+void VideoProcessorController::detected(const cvqm::DetectionZone *zone, cvqm::Entity *e, Mat &frame)
 {
 	double dir, vel;
 	e->calculateVelocityBearing(vel, dir, zone->pixelsPerMeter);
@@ -127,21 +127,20 @@ void VideoProcessorController::newMaskZone(int x, int y, int w, int h)
 
 void VideoProcessorController::newDectionZone(const string name, int x, int y, int w, int h, double pixelsPerMeter, bool directional, double acceptAngle, double acceptWidth)
 {
-	acceptAngle = acceptAngle * M_PI / 180.0 - 0.5*M_PI;
-	if ( acceptAngle < 0 )
-		acceptAngle += 2*M_PI;
-	acceptWidth = acceptWidth * M_PI / 180.0;
-	this->p.addDetectionZone(DetectionZone(name, Rect(x, y, w, h), pixelsPerMeter, directional, acceptAngle, acceptWidth));
+	this->p.addDetectionZone(DetectionZone::fromDegrees(name, Rect(x, y, w, h), pixelsPerMeter, directional, acceptAngle, acceptWidth));
 }
 
 void VideoProcessorController::deleteZonesAt(int x, int y)
 {
-	this->p.removeDetectionZones([x, y](DetectionZone *z){
+	this->p.removeDetectionZones([x, y](const DetectionZone *z){
 			return VideoProcessor::contains(z->zone, Point2i(x,y));
 	});
-	this->p.removeMaskZones([x, y](Rect *z){
+	this->p.removeMaskZones([x, y](const Rect *z){
 			return VideoProcessor::contains(*z, Point2i(x,y));
 	});
+	this->p.removeMaskPolygons([x, y](const vector<Point> *polygon){
+			return pointPolygonTest(*polygon, Point2f(x, y), false) >= 0;
+	});
 }
 
 void VideoProcessorController::requestDetectionSettingsDialog()
@@ -50,7 +50,7 @@ private:
 public:
 	VideoProcessorController();
 	virtual ~VideoProcessorController() override;
-	void detected(cvqm::DetectionZone *zone, cvqm::Entity *e, cv::Mat &frame) override;
+	void detected(const cvqm::DetectionZone *zone, cvqm::Entity *e, cv::Mat &frame) override;
 	void renderedImage(const cv::Mat *image) override;
 
 
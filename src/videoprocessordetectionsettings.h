@@ -22,11 +22,40 @@
 
 namespace cvqm {
 	struct VideoProcessorDetectionSettings;
+
+	// Smoothing applied to the frame and background before they are compared
+	enum BlurEngine {
+		BLUR_GAUSSIAN = 0,  // blur_radius square Gaussian with blur_stdev
+		BLUR_BOX = 1,       // running mean over blur_radius square
+		BLUR_STACK = 2,     // triangular weights, approximating the Gaussian
+		BLUR_INTEGRAL = 3   // mean from running row and column sums, clipped at the frame edges
+	};
+
+	// Shape of the dilation applied to the threshold masks
+	enum DilateEngine {
+		DILATE_ELLIPSE = 0,    // OpenCV's dilate with an ellipse kernel
+		DILATE_RECTANGLE = 1,  // the ellipse's bounding square, separably
+		DILATE_OCTAGON = 2     // row, column and diagonals, approximating the ellipse
+	};
+
+	// How the detected rects are shared out among the tracked entities
+	enum AssignEngine {
+		ASSIGN_GREEDY = 0,  // each entity takes its best rect; a rect taken twice updates neither
+		ASSIGN_OPTIMAL = 1  // one rect per entity, for the greatest total confidence
+	};
+
+	// How an entity's velocity is estimated from its boxes
+	enum MotionModel {
+		MOTION_AVERAGE = 0,        // mean of the steps between the last boxes
+		MOTION_LEAST_SQUARES = 1,  // line fitted through the last boxes
+		MOTION_KALMAN = 2          // constant velocity Kalman filter
+	};
 }
 
 struct cvqm::VideoProcessorDetectionSettings {
 	int blur_radius = 13;
 	double blur_stdev = 1.5;
+	BlurEngine blur_engine = BLUR_GAUSSIAN;
 	int blending_threshold = 12;
 	int detection_threshold = 20;
 	unsigned long threshold_timeout = 25 * 5;
@@ -37,8 +66,17 @@ struct cvqm::VideoProcessorDetectionSettings {
 	float foreground_overload_level = 0.5f;
 	int dilateDetectionFactor = 7;
 	int dilateBlendingFactor = 11;
+	DilateEngine dilate_engine = DILATE_ELLIPSE;
+	AssignEngine assign_engine = ASSIGN_GREEDY;
+	MotionModel motion_model = MOTION_AVERAGE;
 	int borderWidth = 20;
 	bool greyscale = true;
+	int processing_scale = 1;  // detect on frames reduced by this factor; radii and factors are in reduced pixels
+	bool blurred_background = false;  // blend a pre-blurred background model rather than blur it every frame; see README
+	int pixel_threads = 1;  // threads for the per-pixel passes, 0 for one per core
+	bool restrict_to_zones = false;  // only process around the detection zones, less edge mask zones
+	int zone_margin = 100;  // capture pixels kept around the detection zones for approaching entities
+	int strip_rows = 0;  // rows per band pushed through blur to dilate together, 0 for whole frames
 };
 
 #endif // VIDEOPROCESSORDETECTIONSETTINGS_H
@@ -0,0 +1,47 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef VIDEOPROCESSORSNAPSHOT_H
+#define VIDEOPROCESSORSNAPSHOT_H
+
+#include <vector>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+#include "detectionzone.h"
+#include "videoprocessordetectionsettings.h"
+
+namespace cvqm {
+	struct VideoProcessorSnapshot;
+}
+
+/*
+ * Immutable view of the user-editable VideoProcessor state.  Edits publish
+ * a new snapshot with a higher version; each frame picks up the latest one
+ * when it is captured and uses it throughout the pipeline.
+ */
+struct cvqm::VideoProcessorSnapshot {
+	unsigned long version = 0;
+	VideoProcessorDetectionSettings settings;
+	std::vector<std::shared_ptr<const DetectionZone>> detectionZones;
+	std::vector<cv::Rect> maskZones;
+	std::vector<std::vector<cv::Point>> maskPolygons;
+};
+
+#endif // VIDEOPROCESSORSNAPSHOT_H
@@ -0,0 +1,38 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef VIDEOPROCESSORSTATISTICS_H
+#define VIDEOPROCESSORSTATISTICS_H
+
+namespace cvqm {
+	struct VideoProcessorStatistics;
+}
+
+struct cvqm::VideoProcessorStatistics {
+	unsigned long frames = 0;
+	double fps = 0;
+	double latency = 0;     // capture to output, milliseconds
+	double maxLatency = 0;
+	unsigned long bufferAllocations = 0;  // should stop growing after the first few frames
+	double skippedPixels = 0;  // fraction of the last frame outside the processing region
+	double correlationTime = 0;  // running mean, milliseconds
+	double updatedEntities = 0;  // running mean fraction of tracked entities updated each frame
+};
+
+#endif // VIDEOPROCESSORSTATISTICS_H
@@ -0,0 +1,115 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <algorithm>
+#include <exception>
+
+#include "workerpool.h"
+
+using namespace std;
+using namespace cvqm;
+
+WorkerPool::WorkerPool(unsigned threadCount)
+{
+	if ( threadCount == 0 )
+		threadCount = max(1u, thread::hardware_concurrency());
+	for(unsigned i=0; i<threadCount; i++)
+		threads.push_back(thread(&WorkerPool::work, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(m);
+		stopping = true;
+	}
+	available.notify_all();
+	for(thread &t: threads)
+		t.join();
+}
+
+void WorkerPool::submit(function<void()> task)
+{
+	{
+		lock_guard<mutex> lock(m);
+		tasks.push_back(move(task));
+	}
+	available.notify_one();
+}
+
+void WorkerPool::parallelFor(size_t count, const function<void(size_t)> &body)
+{
+	if ( count == 0 )
+		return;
+
+	// The tasks refer to this frame, so it is not left until all of them
+	// are done, even when a body throws.  The first exception is rethrown.
+	mutex doneMutex;
+	condition_variable done;
+	size_t remaining = count - 1;
+	exception_ptr failure;
+	for(size_t i=1; i<count; i++)
+		submit([&, i]() {
+			exception_ptr thrown;
+			try {
+				body(i);
+			} catch (...) {
+				thrown = current_exception();
+			}
+			lock_guard<mutex> lock(doneMutex);
+			if ( thrown && !failure )
+				failure = thrown;
+			if ( --remaining == 0 )
+				done.notify_one();
+		});
+
+	exception_ptr thrown;
+	try {
+		body(0);
+	} catch (...) {
+		thrown = current_exception();
+	}
+	unique_lock<mutex> lock(doneMutex);
+	done.wait(lock, [&remaining]{ return remaining == 0; });
+	if ( !thrown )
+		thrown = failure;
+	if ( thrown )
+		rethrow_exception(thrown);
+}
+
+size_t WorkerPool::size() const
+{
+	return threads.size();
+}
+
+void WorkerPool::work()
+{
+	for(;;) {
+		function<void()> task;
+		{
+			unique_lock<mutex> lock(m);
+			available.wait(lock, [this]{ return stopping || !tasks.empty(); });
+			if ( tasks.empty() )
+				return;
+			task = move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,64 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace cvqm {
+	class WorkerPool;
+}
+
+/*
+ * Fixed set of threads executing submitted tasks in FIFO order.  Tasks must
+ * not throw.  Destruction completes the queued tasks and joins the threads.
+ */
+class cvqm::WorkerPool
+{
+private:
+	std::vector<std::thread> threads;
+	std::mutex m;
+	std::condition_variable available;
+	std::deque<std::function<void()>> tasks;
+	bool stopping = false;
+
+	void work();
+
+public:
+	// A thread count of zero sizes the pool to the number of cores
+	explicit WorkerPool(unsigned threadCount = 0);
+	~WorkerPool();
+
+	void submit(std::function<void()> task);
+	size_t size() const;
+
+	// Runs body(0) .. body(count-1) on the pool and the calling thread, and
+	// returns once all have completed.  If any of them throws, the first
+	// exception is rethrown once all have completed.  Must not be called
+	// from a task of this pool.
+	void parallelFor(size_t count, const std::function<void(size_t)> &body);
+};
+
+#endif // WORKERPOOL_H
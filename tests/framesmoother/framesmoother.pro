@@ -0,0 +1,19 @@
+QT       += testlib
+QT       -= gui
+
+TARGET = tst_framesmoother
+TEMPLATE = app
+CONFIG += console testcase c++11
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -std=c++11
+
+INCLUDEPATH += ../../src/
+
+SOURCES += \
+    tst_framesmoother.cpp \
+    ../../src/framesmoother.cpp
+
+HEADERS += \
+    ../../src/framesmoother.h
+
+LIBS +=`pkg-config opencv --cflags --libs`
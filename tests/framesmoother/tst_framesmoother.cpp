@@ -0,0 +1,196 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <QtTest>
+#include <vector>
+
+#include "framesmoother.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+Q_DECLARE_METATYPE(cvqm::BlurEngine)
+
+/*
+ * Checks that every blur engine gives the same pixels, to the bit, however
+ * the rows are split into ranges, as strip_rows bands and masked rows split
+ * them, when filtering in place, and when the source is a view into a larger
+ * frame, as a restricted processing region is, and times each engine on a
+ * camera-sized frame.
+ */
+class FrameSmootherTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	Mat frame[2];  // greyscale and colour
+
+	static Mat smoothed(FrameSmoother &smoother, const Mat &src, const vector<Range> &ranges)
+	{
+		Mat dst(src.size(), src.type(), Scalar::all(0));
+		for(const Range &r: ranges)
+			smoother.apply(src, dst, r);
+		return dst;
+	}
+
+	static vector<Range> bands(int rows, int bandRows)
+	{
+		vector<Range> ranges;
+		for(int y=0; y < rows; y += bandRows)
+			ranges.push_back(Range(y, min(rows, y + bandRows)));
+		return ranges;
+	}
+
+	static bool identical(const Mat &a, const Mat &b)
+	{
+		return a.size() == b.size() && a.type() == b.type() && norm(a, b, NORM_INF) == 0;
+	}
+
+private slots:
+	void initTestCase();
+	void rangesMatchWholeFrame_data();
+	void rangesMatchWholeFrame();
+	void inPlaceMatchesCopy_data();
+	void inPlaceMatchesCopy();
+	void benchmarkApply_data();
+	void benchmarkApply();
+};
+
+void FrameSmootherTest::initTestCase()
+{
+	// Noise over smooth shapes, so that rounding is exercised at every level
+	RNG random(5);
+	for(int i=0; i < 2; i++) {
+		Mat shapes(240, 360, i == 0 ? CV_8UC1 : CV_8UC3, Scalar::all(90));
+		for(int k=0; k < 30; k++) {
+			Point centre(random.uniform(0, shapes.cols), random.uniform(0, shapes.rows));
+			circle(shapes, centre, random.uniform(5, 60), Scalar::all(random.uniform(0, 256)), FILLED);
+		}
+		Mat noise(shapes.size(), shapes.type());
+		random.fill(noise, RNG::UNIFORM, 0, 40);
+		frame[i] = shapes + noise;
+	}
+}
+
+void FrameSmootherTest::rangesMatchWholeFrame_data()
+{
+	QTest::addColumn<BlurEngine>("engine");
+	QTest::addColumn<int>("kernelSize");
+	QTest::addColumn<int>("channels");
+
+	const BlurEngine engines[] = { BLUR_GAUSSIAN, BLUR_BOX, BLUR_STACK, BLUR_INTEGRAL };
+	for(BlurEngine engine: engines) {
+		for(int kernelSize: { 3, 8, 13 }) {
+			if ( engine == BLUR_GAUSSIAN && kernelSize % 2 == 0 )
+				continue;
+			for(int channels: { 1, 3 })
+				QTest::newRow(qPrintable(QString("%1 %2 %3ch").arg(FrameSmoother::name(engine)).arg(kernelSize).arg(channels)))
+					<< engine << kernelSize << channels;
+		}
+	}
+}
+
+void FrameSmootherTest::rangesMatchWholeFrame()
+{
+	QFETCH(BlurEngine, engine);
+	QFETCH(int, kernelSize);
+	QFETCH(int, channels);
+
+	FrameSmoother smoother;
+	smoother.configure(engine, kernelSize, 1.5);
+	Mat image = frame[channels == 3];
+
+	// A region away from every edge, and the same pixels as a frame of their own
+	Mat region = image(Rect(13, 7, 301, 203));
+	Mat whole = smoothed(smoother, region, { Range(0, region.rows) });
+	QVERIFY(identical(smoothed(smoother, region.clone(), { Range(0, region.rows) }), whole));
+
+	for(int bandRows: { 1, 5, 16, 64 })
+		QVERIFY2(identical(smoothed(smoother, region, bands(region.rows, bandRows)), whole),
+				 qPrintable(QString("bands of %1 rows").arg(bandRows)));
+
+	// Runs split around masked rows, which are left unfiltered
+	vector<Range> runs = { Range(0, 40), Range(41, 42), Range(60, 150), Range(152, region.rows) };
+	Mat split = smoothed(smoother, region, runs);
+	for(const Range &r: runs)
+		QVERIFY(identical(split.rowRange(r), whole.rowRange(r)));
+}
+
+void FrameSmootherTest::inPlaceMatchesCopy_data()
+{
+	rangesMatchWholeFrame_data();
+}
+
+void FrameSmootherTest::inPlaceMatchesCopy()
+{
+	QFETCH(BlurEngine, engine);
+	QFETCH(int, kernelSize);
+	QFETCH(int, channels);
+
+	FrameSmoother smoother;
+	smoother.configure(engine, kernelSize, 1.5);
+	Mat image = frame[channels == 3];
+	Mat expected = smoothed(smoother, image, { Range(0, image.rows) });
+
+	Mat background = image.clone();
+	smoother.apply(background, background, Range(0, background.rows));
+	QVERIFY(identical(background, expected));
+
+	// A range at a time would read rows an earlier range had smoothed
+	QVERIFY_EXCEPTION_THROWN(smoother.apply(background, background, Range(0, 10)), cv::Exception);
+}
+
+void FrameSmootherTest::benchmarkApply_data()
+{
+	QTest::addColumn<BlurEngine>("engine");
+	QTest::addColumn<int>("channels");
+	QTest::addColumn<int>("bandRows");
+
+	// The default blur_radius, on a camera frame, whole and in strip_rows bands
+	const BlurEngine engines[] = { BLUR_GAUSSIAN, BLUR_BOX, BLUR_STACK, BLUR_INTEGRAL };
+	for(BlurEngine engine: engines)
+		for(int channels: { 1, 3 })
+			for(int bandRows: { 0, 32 })
+				QTest::newRow(qPrintable(QString("%1 %2ch %3").arg(FrameSmoother::name(engine)).arg(channels)
+										 .arg(bandRows > 0 ? QString("bands of %1").arg(bandRows) : QString("whole"))))
+					<< engine << channels << bandRows;
+}
+
+void FrameSmootherTest::benchmarkApply()
+{
+	QFETCH(BlurEngine, engine);
+	QFETCH(int, channels);
+	QFETCH(int, bandRows);
+
+	FrameSmoother smoother;
+	smoother.configure(engine, 13, 1.5);
+	Mat image;
+	resize(frame[channels == 3], image, Size(640, 480));
+	Mat out(image.size(), image.type());
+	vector<Range> ranges = bandRows > 0 ? bands(image.rows, bandRows) : vector<Range>{ Range(0, image.rows) };
+	QBENCHMARK {
+		for(const Range &r: ranges)
+			smoother.apply(image, out, r);
+	}
+}
+
+QTEST_APPLESS_MAIN(FrameSmootherTest)
+
+#include "tst_framesmoother.moc"
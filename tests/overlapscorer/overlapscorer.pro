@@ -0,0 +1,19 @@
+QT       += testlib
+QT       -= gui
+
+TARGET = tst_overlapscorer
+TEMPLATE = app
+CONFIG += console testcase c++11
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -std=c++11
+
+INCLUDEPATH += ../../src/
+
+SOURCES += \
+    tst_overlapscorer.cpp \
+    ../../src/overlapscorer.cpp
+
+HEADERS += \
+    ../../src/overlapscorer.h
+
+LIBS +=`pkg-config opencv --cflags --libs`
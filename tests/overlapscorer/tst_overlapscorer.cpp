@@ -0,0 +1,154 @@
+/************************************************************************
+ * CvqMotion - A Motion Tracking Webcam Application
+ * Copyright (C) 2018, Corey Edmunds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ ************************************************************************/
+
+#include <QtTest>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "overlapscorer.h"
+
+using namespace cv;
+using namespace std;
+using namespace cvqm;
+
+/*
+ * Checks that the batched scorer gives the types and ratios, to the bit, of
+ * the pair by pair overlaps() on random layouts, including empty boxes and
+ * boxes sharing edges, and times the two against each other.
+ */
+class OverlapScorerTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	static constexpr int BENCHMARK_BOXES = 500;
+
+	OverlapScorer scorer;
+	vector<Rect> boxes;
+	vector<Rect> rects;
+	vector<int> items;
+	vector<OverlapType> types;
+	vector<double> ratios;
+
+	static bool sameRatio(double a, double b)
+	{
+		if ( std::isnan(a) || std::isnan(b) )
+			return std::isnan(a) && std::isnan(b);
+		return memcmp(&a, &b, sizeof(double)) == 0;
+	}
+
+private slots:
+	void initTestCase();
+	void matchesPairwise();
+	void containsIncludesEdges();
+	void benchmarkScore();
+	void benchmarkOverlaps();
+};
+
+void OverlapScorerTest::initTestCase()
+{
+	// A crowded frame: every rect against every box
+	mt19937 random(11);
+	auto box = [&random]() {
+		return Rect(random() % 600, random() % 440, random() % 40 + 1, random() % 40 + 1);
+	};
+	for(int k=0; k < BENCHMARK_BOXES; k++) {
+		boxes.push_back(box());
+		rects.push_back(box());
+		scorer.add(boxes.back());
+		items.push_back(k);
+	}
+}
+
+void OverlapScorerTest::matchesPairwise()
+{
+	mt19937 random(7);
+	auto coordinate = [&random]() { return static_cast<int>(random() % 200) - 20; };
+	auto extent = [&random]() { return static_cast<int>(random() % 60) + (random() % 8 == 0 ? 0 : 1); };
+
+	int counts[OVERLAP_TYPE_OVERLAPS + 1] = {};
+	for(int layout=0; layout < 20000; layout++) {
+		OverlapScorer s;
+		vector<Rect> layoutBoxes;
+		int n = random() % 40;
+		for(int k=0; k < n; k++) {
+			layoutBoxes.push_back(Rect(coordinate(), coordinate(), extent(), extent()));
+			s.add(layoutBoxes.back());
+		}
+		Rect r(coordinate(), coordinate(), extent(), extent());
+
+		// Only some boxes are scored, in the order given, as correlation does
+		vector<int> scored;
+		for(int k=0; k < n; k++)
+			if ( random() % 3 != 0 )
+				scored.push_back(k);
+		s.score(r, scored, types, ratios);
+		QCOMPARE(types.size(), scored.size());
+
+		for(size_t k=0; k < scored.size(); k++) {
+			double expected = 0;
+			OverlapType type = OverlapScorer::overlaps(r, layoutBoxes[scored[k]], expected);
+			counts[type]++;
+			QCOMPARE(types[k], type);
+			QVERIFY2(sameRatio(ratios[k], expected), qPrintable(QString("layout %1 box %2: %3 against %4")
+				.arg(layout).arg(scored[k]).arg(ratios[k], 0, 'g', 17).arg(expected, 0, 'g', 17)));
+		}
+	}
+
+	// Every case was reached
+	QVERIFY(counts[OVERLAP_TYPE_NONE] > 0);
+	QVERIFY(counts[OVERLAP_TYPE_CONTAINS] > 0);
+	QVERIFY(counts[OVERLAP_TYPE_CONTAINED] > 0);
+	QVERIFY(counts[OVERLAP_TYPE_OVERLAPS] > 0);
+}
+
+void OverlapScorerTest::containsIncludesEdges()
+{
+	Rect r(10, 20, 30, 5);
+	QVERIFY(OverlapScorer::contains(r, Point(10, 20)));
+	QVERIFY(OverlapScorer::contains(r, Point(40, 25)));
+	QVERIFY(!OverlapScorer::contains(r, Point(40, 26)));
+	QVERIFY(!OverlapScorer::contains(r, Point(41, 25)));
+	QVERIFY(!OverlapScorer::contains(r, Point(10, 19)));
+}
+
+void OverlapScorerTest::benchmarkScore()
+{
+	QBENCHMARK {
+		for(const Rect &r: rects)
+			scorer.score(r, items, types, ratios);
+	}
+}
+
+void OverlapScorerTest::benchmarkOverlaps()
+{
+	types.resize(items.size());
+	ratios.resize(items.size());
+	QBENCHMARK {
+		for(const Rect &r: rects)
+			for(size_t k=0; k < items.size(); k++)
+				types[k] = OverlapScorer::overlaps(r, boxes[items[k]], ratios[k]);
+	}
+}
+
+QTEST_APPLESS_MAIN(OverlapScorerTest)
+
+#include "tst_overlapscorer.moc"
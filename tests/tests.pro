@@ -0,0 +1,12 @@
+#-------------------------------------------------
+#
+# Unit tests and microbenchmarks for the engine classes.  Build in
+# build/tests/ with "qmake -qt5 ../../tests/" and run with "make check".
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    framesmoother \
+    overlapscorer